@@ -0,0 +1,18 @@
+function compact_bench --argument times threads_start threads_step threads_end --description="Measures parallel_filter against std::erase_if on lists of the size of every graph file given after the arguments, for different thread counts"
+    # usage: compact_bench 10 1 1 24 graphs/web.mtx graphs/road.mtx
+    set files $argv[5..-1]
+
+    mkdir -p results/compact
+
+    cd OpenMP
+    make clean
+    make
+    for i in (seq $threads_start $threads_step $threads_end)
+        export OMP_NUM_THREADS=$i
+        echo "Compacting with $i threads"
+        for file in $files
+            ./colorSCC $file $times 0 0 --bench-compact | tee -a ../results/compact/threads_$i.txt
+        end
+    end
+    cd ..
+end
@@ -0,0 +1,18 @@
+function load_bench --argument times threads_start threads_step threads_end --description="Measures the loading throughput of every graph file given after the arguments, for different thread counts"
+    # usage: load_bench 5 1 1 12 graphs/web.mtx graphs/web.txt.gz graphs/web.graph graphs/web.gr
+    set files $argv[5..-1]
+
+    mkdir -p results/load
+
+    cd OpenMP
+    make clean
+    make
+    for i in (seq $threads_start $threads_step $threads_end)
+        export OMP_NUM_THREADS=$i
+        echo "Loading with $i threads"
+        for file in $files
+            ./colorSCC $file $times 0 0 --bench-load | tee -a ../results/load/threads_$i.txt
+        end
+    end
+    cd ..
+end
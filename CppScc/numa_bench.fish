@@ -0,0 +1,26 @@
+function numa_bench --argument times threads_start threads_step threads_end --description="Measures the scaling of the OpenMP version across sockets, for first touch and interleaved placement of the arrays"
+    # usage: numa_bench 5 1 1 48
+    # close binding fills one socket before using the next, spread alternates between the sockets from the start,
+    # so the jump in the close results when the second socket is reached shows the cost of remote memory
+    mkdir -p results/numa
+
+    cd OpenMP
+    make clean
+    make
+    export OMP_PLACES=cores
+    for placement in first-touch interleave
+        set flags
+        if test $placement = interleave
+            set flags --numa-interleave
+        end
+        for bind in close spread
+            export OMP_PROC_BIND=$bind
+            for i in (seq $threads_start $threads_step $threads_end)
+                export OMP_NUM_THREADS=$i
+                echo "Running with $i threads, $placement placement, $bind binding"
+                ./colorSCC ../../matrices $times 0 1 $flags | tee ../results/numa/$placement"_"$bind"_threads_"$i.txt
+            end
+        end
+    end
+    cd ..
+end
@@ -1,26 +1,98 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <numeric>
 #include <vector>
+#include <limits>
 #include <string>
 #include <queue>
-#include <unordered_set>
 #include <chrono>
-#include <iterator>
 #include <list>
 #include <optional>
 #include <atomic>
+#include <type_traits>
 
 #include "sparse_util.hpp"
 #include "colorSCC.hpp"
+#include "parallel_util.hpp"
 
 #include <pthread.h>
 
 #define BFS_GRAIN_SIZE 3
 #define COLOR_GRAIN_SIZE 1000
 
-#define UNCOMPLETED_SCC_ID -1
-#define MAX_COLOR -1
+// the largest value of the vertex type, functions using these have a Vertex type in scope
+#define UNCOMPLETED_SCC_ID std::numeric_limits<Vertex>::max()
+#define MAX_COLOR std::numeric_limits<Vertex>::max()
+
+// levels of the FW-BW searches and of the worklist trim smaller than this are expanded by the calling thread
+#define PARALLEL_FRONTIER_MIN 256
+
+// the frontier coloring goes over all of vleft instead of a list when more than 1 / DENSE_FRONTIER_DIVISOR of it changed color
+#define DENSE_FRONTIER_DIVISOR 20
+
+// the push coloring pushes while the frontier has fewer than 1 / PUSH_PULL_ALPHA of the edges into vleft, as in Beamer et al.
+#define PUSH_PULL_ALPHA 14
+
+// the colors with at least this many vertices get the parallel BFS
+#define PARALLEL_BFS_MIN_VERTICES 65536
+
+// the rest of the algorithm runs on the subgraph of the vertices left once fewer than 1 / COMPACT_LIVE_DIVISOR of them are left
+#define COMPACT_LIVE_DIVISOR 8
+
+// out of core, the coloring asks for the lists of this many vertices of vleft at a time, ahead of the sweep
+#define READAHEAD_VERTICES 4096
+
+// the size of the cache lines, see Change_flag
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief The flag a thread sets when its part of a coloring sweep changed a color, one per thread. Each one is on its
+ * own cache line, so setting it does not invalidate the flags of the other threads, and the sweep is done when none of
+ * them are set.
+ */
+struct alignas(CACHE_LINE_SIZE) Change_flag {
+    bool changed = false;
+};
+
+/**
+ * @brief Reads a value that other threads may write at the same time. Relaxed, so a plain load on x86.
+ * @param value the value, shared between threads
+ * @return the value
+ */
+template <typename T>
+T load_relaxed(const T& value) {
+    // atomic_ref needs a non const reference even to load, the value itself is never const
+    return std::atomic_ref<T>(const_cast<T&>(value)).load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Writes a value that other threads may read at the same time. Relaxed, so a plain store on x86.
+ * @param value the value, shared between threads
+ * @param desired the new value
+ * @return (void)
+ */
+template <typename T>
+void store_relaxed(T& value, const std::type_identity_t<T> desired) {
+    std::atomic_ref<T>(value).store(desired, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Lowers value to desired if desired is smaller, with a compare and swap loop, as std::atomic has no fetch_min
+ * @param value the value, shared between threads
+ * @param desired the new value
+ * @return true if this call lowered the value
+ */
+template <typename T>
+bool atomic_fetch_min(T& value, const T desired) {
+    std::atomic_ref<T> ref(value);
+    T current = ref.load(std::memory_order_relaxed);
+    while(desired < current) {
+        if(ref.compare_exchange_weak(current, desired, std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
 
 /**
  * @brief A trimming function, without checking for removed vertices, and without taking into account the vertices it trims in the neighbor number calculation
@@ -29,15 +101,17 @@
  * @param SCC_id the SCC id of each vertex, needed to save assign the SCC id of the trimmed vertices
  * @param SCC_count the number of SCCs found so far, needed to calculate the scc id of the trimmed vertices
  * @return the number of trimmed vertices
- */size_t trimVertices_inplace_first_time(const Sparse_matrix& inb, const Sparse_matrix& onb, std::vector<size_t>& SCC_id, const size_t SCC_count) { 
+ */
+template <typename Matrix>
+size_t trimVertices_inplace_first_time(const Matrix& inb, const Matrix& onb, Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) { 
     std::atomic<size_t> trimed(0);
 
     for(size_t source = 0; source < inb.n; source++) {
         // the distance between the pointers is the number of neighbors
         // 0 means no neighbors
-        bool hasIncoming = inb.ptr[source] != inb.ptr[source + 1];
+        bool hasIncoming = inb.has_neighbors(source);
 
-        bool hasOutgoing = onb.ptr[source] != onb.ptr[source + 1];
+        bool hasOutgoing = onb.has_neighbors(source);
 
         if(!hasIncoming | !hasOutgoing) {
             SCC_id[source] = SCC_count + ++trimed;
@@ -53,18 +127,19 @@
  * @param SCC_count the number of SCCs found so far, needed to calculate the scc id of the trimmed vertices
  * @return the number of trimmed vertices
  */
-size_t trimVertices_inplace_first_time_single_direction(const Sparse_matrix& nb, std::vector<size_t>& SCC_id, const size_t SCC_count) { 
+template <typename Matrix>
+size_t trimVertices_inplace_first_time_single_direction(const Matrix& nb, Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) { 
+    using Vertex = typename Matrix::Vertex;
     size_t trimed = 0;
 
     std::vector<bool> hasOtherWay(nb.n, false);
 
     for(size_t source = 0; source < nb.n; source++) {
         // the distance between the pointers is the number of neighbors
-        if(nb.ptr[source] == nb.ptr[source + 1]) {
+        if(!nb.has_neighbors(source)) {
             SCC_id[source] = SCC_count + ++trimed;
         } else {
-            for (size_t i = nb.ptr[source]; i < nb.ptr[source + 1]; i++) {
-                size_t neighbor = nb.val[i];
+            for(const size_t neighbor : nb.neighbors(source)) {
                 hasOtherWay[neighbor] = true;
             }
         }
@@ -89,8 +164,10 @@ size_t trimVertices_inplace_first_time_single_direction(const Sparse_matrix& nb,
  * @param SCC_count the number of SCCs found so far, needed to calculate the scc id of the trimmed vertices
  * @return the number of trimmed vertices
  */
-size_t trimVertices_inplace(const Sparse_matrix& inb, const Sparse_matrix& onb, const std::vector<size_t>& vleft,
-                                    std::vector<size_t>& SCC_id, const size_t SCC_count) { 
+template <typename Matrix>
+size_t trimVertices_inplace(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                    Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) { 
+    using Vertex = typename Matrix::Vertex;
     size_t trimed = 0;
 
     // check for non-trimmed neighbors of the source vertex in both directions
@@ -98,16 +175,16 @@ size_t trimVertices_inplace(const Sparse_matrix& inb, const Sparse_matrix& onb,
         const size_t source = vleft[index];
 
         bool hasIncoming = false;
-        for(size_t i = inb.ptr[source]; i < inb.ptr[source + 1]; i++) {
-            if(SCC_id[inb.val[i]] == UNCOMPLETED_SCC_ID) {
+        for(const size_t neighbor : inb.neighbors(source)) {
+            if(SCC_id[neighbor] == UNCOMPLETED_SCC_ID) {
                 hasIncoming = true;
                 break;
             }
         }
 
         bool hasOutgoing = false;
-        for(size_t i = onb.ptr[source]; i < onb.ptr[source + 1]; i++) {
-            if(SCC_id[onb.val[i]] == UNCOMPLETED_SCC_ID) {
+        for(const size_t neighbor : onb.neighbors(source)) {
+            if(SCC_id[neighbor] == UNCOMPLETED_SCC_ID) {
                 hasOutgoing = true;
                 break;
             }
@@ -129,8 +206,10 @@ size_t trimVertices_inplace(const Sparse_matrix& inb, const Sparse_matrix& onb,
  * @param SCC_count the number of SCCs found so far, needed to calculate the scc id of the trimmed vertices
  * @return the number of trimmed vertices
  */
-size_t trimVertices_inplace_single_direction(const Sparse_matrix& nb, const std::vector<size_t>& vleft,
-                                        std::vector<size_t>& SCC_id, size_t SCC_count) { 
+template <typename Matrix>
+size_t trimVertices_inplace_single_direction(const Matrix& nb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                        Numa_vector<typename Matrix::Vertex>& SCC_id, size_t SCC_count) { 
+    using Vertex = typename Matrix::Vertex;
 
     //size_t trimed = 0;
     size_t trimed = 0;
@@ -144,9 +223,7 @@ size_t trimVertices_inplace_single_direction(const Sparse_matrix& nb, const std:
         size_t source = vleft[index];
 
         bool hasOneWay = false;
-        for(size_t i = nb.ptr[source]; i < nb.ptr[source + 1]; i++) {
-            size_t neighbor = nb.val[i];
-
+        for(const size_t neighbor : nb.neighbors(source)) {
             // if SCC_id[neighbor] == UNCOMPLETED_SCC_ID, then neighbor in vleft
             if(SCC_id[neighbor] == UNCOMPLETED_SCC_ID) {
                 hasOneWay = true;
@@ -170,6 +247,28 @@ size_t trimVertices_inplace_single_direction(const Sparse_matrix& nb, const std:
 }
 
 
+/**
+ * @brief The first trim from the degrees alone, see First_trim. Serial, as it runs on its own thread next to the
+ * parallel scatter of the loader. The degrees may count edges that canonicalizing removes later, so this trims a subset
+ * of what trimVertices_inplace_first_time would, the rest are trimmed by the later trims.
+ * @param n the number of vertices
+ * @param in_ptr the offsets of the CSC
+ * @param out_ptr the offsets of the CSR, or nullptr to only trim the vertices without incoming edges
+ * @return the SCC ids of the trimmed vertices and their number
+ */
+template <typename VertexT, typename OffsetT>
+First_trim<VertexT> trimFromDegrees(const size_t n, const OffsetT* in_ptr, const OffsetT* out_ptr) {
+    using Vertex = VertexT;
+    First_trim<Vertex> trim{Numa_vector<Vertex>(n), 0};
+
+    for(size_t v = 0; v < n; v++) {
+        const bool hasIncoming = in_ptr[v + 1] != in_ptr[v];
+        const bool hasOutgoing = out_ptr == nullptr || out_ptr[v + 1] != out_ptr[v];
+        trim.SCC_id[v] = (!hasIncoming || !hasOutgoing) ? ++trim.count : UNCOMPLETED_SCC_ID;
+    }
+    return trim;
+}
+
 /**
  * @brief BFS that changes the SCC_id of all vertices it reaches that have the given color. Assumes that the SCC_id of the trimmed vertices is already set.
  * @param nb neighbors in the direction of the BFS
@@ -180,20 +279,20 @@ size_t trimVertices_inplace_single_direction(const Sparse_matrix& nb, const std:
  * @param color the color of the vertices that will be assigned the SCC_count
  * @return (void)
  */
-void bfs_colors_inplace( const Sparse_matrix& nb, const size_t source, std::vector<size_t>& SCC_id,
-                                const size_t SCC_count, const std::vector<size_t>& colors, const size_t color) {
+template <typename Matrix>
+void bfs_colors_inplace( const Matrix& nb, const size_t source, Numa_vector<typename Matrix::Vertex>& SCC_id,
+                                const size_t SCC_count, const Numa_vector<typename Matrix::Vertex>& colors, const size_t color) {
+    using Vertex = typename Matrix::Vertex;
     SCC_id[source] = SCC_count;
 
-    std::queue<size_t> q;
+    std::queue<Vertex> q;
     q.push(source);
 
     while(!q.empty()) {
         size_t v = q.front();
         q.pop();
 
-        for(size_t i = nb.ptr[v]; i < nb.ptr[v + 1]; i++) {
-            size_t u = nb.val[i];
-
+        for(const size_t u : nb.neighbors(v)) {
             if(colors[u] == color && SCC_id[u] != SCC_count) {
                 SCC_id[u] = SCC_count;
                 q.push(u);
@@ -205,15 +304,16 @@ void bfs_colors_inplace( const Sparse_matrix& nb, const size_t source, std::vect
 /**
  * @brief Needed for the parallel BFS. Contains all the information needed for the BFS.
  */
+template <typename Matrix>
 struct bfs_partitions_runner_struct
 {
-    const Sparse_matrix* nb;
-    std::vector<size_t>* SCC_id;
+    const Matrix* nb;
+    Numa_vector<typename Matrix::Vertex>* SCC_id;
     size_t SCC_count;
 
     // source and color are found from those below
-    std::vector<size_t>* colors;
-    std::vector<size_t>* unique_colors;
+    Numa_vector<typename Matrix::Vertex>* colors;
+    std::vector<typename Matrix::Vertex>* unique_colors;
     size_t start;
     size_t end;
 
@@ -225,14 +325,17 @@ struct bfs_partitions_runner_struct
  * @param bfs_plus_info A struct containing all the information needed for the BFS
  * @return (void)
  */
-void bfs_partitions_runner(bfs_partitions_runner_struct* bfs_plus_info) {
+template <typename Matrix>
+void bfs_partitions_runner(bfs_partitions_runner_struct<Matrix>* bfs_plus_info) {
+    using Vertex = typename Matrix::Vertex;
+
     const size_t SCC_count = bfs_plus_info->SCC_count;
     const size_t start = bfs_plus_info->start;
     const size_t end = bfs_plus_info->end;
-    const Sparse_matrix& nb = *bfs_plus_info->nb;
-    std::vector<size_t>& SCC_id = *bfs_plus_info->SCC_id;
-    std::vector<size_t>& colors = *bfs_plus_info->colors;
-    std::vector<size_t>& unique_colors = *bfs_plus_info->unique_colors;
+    const Matrix& nb = *bfs_plus_info->nb;
+    Numa_vector<Vertex>& SCC_id = *bfs_plus_info->SCC_id;
+    Numa_vector<Vertex>& colors = *bfs_plus_info->colors;
+    std::vector<Vertex>& unique_colors = *bfs_plus_info->unique_colors;
 
     for(size_t i = start; i < end; i++) {
         size_t color = unique_colors[i];
@@ -247,14 +350,15 @@ void bfs_partitions_runner(bfs_partitions_runner_struct* bfs_plus_info) {
 /**
  * @brief Needed for the parallel coloring. Contains all the information needed for the BFS.
  */
+template <typename Matrix>
 struct coloring_partitions_runner_struct
 {
-    const Sparse_matrix* inb;
-    std::vector<size_t>* colors;
-    const std::vector<size_t>* vleft;
+    const Matrix* inb;
+    Numa_vector<typename Matrix::Vertex>* colors;
+    const Numa_vector<typename Matrix::Vertex>* vleft;
     size_t start;
     size_t end;
-    bool* made_change;
+    Change_flag* changed;
     bool should_quit_after;
 };
 
@@ -263,29 +367,794 @@ struct coloring_partitions_runner_struct
  * @param coloring_info A struct containing all the information needed for the coloring
  * @return (void)
  */
-void coloring_partitions_runner(coloring_partitions_runner_struct* coloring_info) {
+template <typename Matrix>
+void coloring_partitions_runner(coloring_partitions_runner_struct<Matrix>* coloring_info) {
+    using Vertex = typename Matrix::Vertex;
+
     const size_t start = coloring_info->start;
     const size_t end = coloring_info->end;
 
-    const Sparse_matrix& inb = *coloring_info->inb;
-    std::vector<size_t>& colors = *coloring_info->colors;
-    const std::vector<size_t>& vleft = *coloring_info->vleft;
+    const Matrix& inb = *coloring_info->inb;
+    Numa_vector<Vertex>& colors = *coloring_info->colors;
+    const Numa_vector<Vertex>& vleft = *coloring_info->vleft;
 
-    bool& made_change = *coloring_info->made_change;
+    // this thread's own flag, on its own cache line
+    Change_flag& changed = *coloring_info->changed;
 
     for(size_t i = start; i < end; i++) {
         size_t u = vleft[i];
 
-        for(size_t j = inb.ptr[u]; j < inb.ptr[u + 1]; j++) {
-            size_t v = inb.val[j];
+        // only does something when the graph is mapped from disk: start reading the next lists before the sweep reaches them
+        if(i % READAHEAD_VERTICES == 0) {
+            inb.will_need(vleft[i], vleft[std::min(i + 2 * READAHEAD_VERTICES, end) - 1] + 1);
+        }
+
+        // the colors of the neighbors are written by the other threads in the same sweep, so they are read atomically,
+        // and only u is lowered to the smallest of them
+        Vertex new_color = load_relaxed(colors[u]);
+        for(const size_t v : inb.neighbors(u)) {
+            new_color = std::min(new_color, load_relaxed(colors[v]));
+        }
+        if(atomic_fetch_min(colors[u], new_color)) {
+            changed.changed = true;
+        }
+    }
+}
+
+/**
+ * @brief Collects the vertices that visit(v, keep) keeps for the vertices v of input, in parallel: the input is split in
+ * one block per worker, every block keeps its vertices in its own list, and the lists are joined into output with a
+ * prefix sum of their sizes. Used for the levels of the frontier searches, output may be input.
+ * @param input the vertices to visit
+ * @param output the vertices kept, in the order of the blocks
+ * @param found the lists of the blocks, reused between calls
+ * @param visit called with every vertex of input and a function that keeps a vertex
+ * @return (void)
+ */
+template <typename Vertex, typename Input, typename Visit>
+void collect_parallel(const Input& input, std::vector<Vertex>& output, std::vector<std::vector<Vertex>>& found, Visit visit) {
+    // the small levels of the start and the end of a search are not worth waking the workers
+    const size_t blocks = input.size() < PARALLEL_FRONTIER_MIN ? 1 : num_workers();
+    found.resize(std::max(found.size(), blocks));
+    auto expand = [&](size_t b) {
+        found[b].clear();
+        auto keep = [&](size_t u) { found[b].push_back(u); };
+        for(size_t k = b * input.size() / blocks; k < (b + 1) * input.size() / blocks; k++) {
+            visit(input[k], keep);
+        }
+    };
+    if(blocks == 1) {
+        expand(0);
+    } else {
+        parallel_for(0, blocks, expand);
+    }
+
+    std::vector<size_t> offsets(blocks + 1);
+    for(size_t b = 0; b < blocks; b++) {
+        offsets[b] = found[b].size();
+    }
+    output.resize(parallel_exclusive_scan(offsets.data(), blocks + 1));
+
+    parallel_for(0, blocks, [&](size_t b) {
+        std::copy(found[b].begin(), found[b].end(), output.begin() + offsets[b]);
+    });
+}
+
+/**
+ * @brief The sum of the degrees of a list of vertices, by blocks
+ * @param nb the neighbors to count
+ * @param list the vertices
+ * @return the number of edges
+ */
+template <typename Matrix, typename List>
+size_t degree_sum(const Matrix& nb, const List& list) {
+    const size_t blocks = list.size() < PARALLEL_FRONTIER_MIN ? 1 : num_workers();
+    std::vector<size_t> sums(blocks, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        for(size_t k = b * list.size() / blocks; k < (b + 1) * list.size() / blocks; k++) {
+            sums[b] += nb.degree(list[k]);
+        }
+    });
+    return std::accumulate(sums.begin(), sums.end(), size_t(0));
+}
 
-            size_t new_color = colors[v];
-            if(new_color < colors[u]) {
-                colors[u] = new_color;
-                made_change = true;
+/**
+ * @brief Marks the uncompleted vertices reachable from source through nb, level by level. Every level is collected
+ * with collect_parallel, the blocks claim the unmarked neighbors of their vertices with an atomic exchange.
+ * @param nb the neighbors to follow: outgoing for the forward search, incoming for the backward one
+ * @param source the vertex to start from
+ * @param SCC_id only the vertices with UNCOMPLETED_SCC_ID are visited
+ * @param reached set for every vertex reached, expected to be all false
+ * @return (void)
+ */
+template <typename Matrix>
+void reach_inplace(const Matrix& nb, const size_t source, const Numa_vector<typename Matrix::Vertex>& SCC_id, Numa_vector<char>& reached) {
+    using Vertex = typename Matrix::Vertex;
+
+    std::vector<Vertex> frontier(1, source);
+    reached[source] = true;
+
+    std::vector<std::vector<Vertex>> found;
+    while(!frontier.empty()) {
+        collect_parallel(frontier, frontier, found, [&](size_t v, auto keep) {
+            for(const size_t u : nb.neighbors(v)) {
+                if(SCC_id[u] != UNCOMPLETED_SCC_ID) continue;
+
+                // only the block that sets the flag keeps u
+                std::atomic_ref<char> flag(reached[u]);
+                if(!flag.load(std::memory_order_relaxed) && !flag.exchange(true, std::memory_order_relaxed)) {
+                    keep(u);
+                }
             }
+        });
+    }
+}
+
+/**
+ * @brief The forward-backward step of Multistep: the SCC of a pivot is the intersection of the vertices it reaches
+ * and the vertices that reach it. The pivot is the vertex of vleft with the largest in-degree * out-degree, the one
+ * most likely to be in the giant SCC of a web graph, which this takes in two searches instead of one coloring sweep
+ * per unit of its diameter.
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param vleft the vertices that are left, none of them trimmed yet
+ * @param SCC_id the SCC id of each vertex, the SCC of the pivot gets SCC_count + 1
+ * @param SCC_count the number of SCCs found so far
+ * @return the number of vertices of the SCC of the pivot, 0 if vleft is empty
+ */
+template <typename Matrix>
+size_t fwbwPivot(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                 Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) {
+    using Vertex = typename Matrix::Vertex;
+    if(vleft.empty()) return 0;
+
+    // the best of every block, then the best of the blocks, the first one on ties
+    const size_t blocks = num_workers();
+    std::vector<std::pair<size_t, Vertex>> best(blocks, {0, vleft[0]});
+    parallel_for(0, blocks, [&](size_t b) {
+        for(size_t k = b * vleft.size() / blocks; k < (b + 1) * vleft.size() / blocks; k++) {
+            const size_t score = inb.degree(vleft[k]) * onb.degree(vleft[k]);
+            if(score > best[b].first) best[b] = {score, vleft[k]};
+        }
+    });
+    const Vertex pivot = std::max_element(best.begin(), best.end(), [](const auto& a, const auto& b) { return a.first < b.first; })->second;
+
+    Numa_vector<char> forward(inb.n);
+    Numa_vector<char> backward(inb.n);
+    reach_inplace(onb, pivot, SCC_id, forward);
+    reach_inplace(inb, pivot, SCC_id, backward);
+
+    std::vector<size_t> block_size(blocks, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        for(size_t k = b * vleft.size() / blocks; k < (b + 1) * vleft.size() / blocks; k++) {
+            const Vertex v = vleft[k];
+            if(forward[v] && backward[v]) {
+                SCC_id[v] = SCC_count + 1;
+                block_size[b]++;
+            }
+        }
+    });
+
+    size_t size = 0;
+    for(const size_t s : block_size) size += s;
+    return size;
+}
+
+/**
+ * @brief The BFS of bfs_colors_inplace for a giant color, level synchronous with every level collected in parallel.
+ * The vertices are claimed with a compare and swap on their SCC id. With onb the direction is chosen every level as in
+ * the direction optimizing BFS of Beamer et al.: top down from the frontier through inb while the frontier has fewer
+ * than 1 / PUSH_PULL_ALPHA of the outgoing edges of the vertices of the color not reached yet, and bottom up
+ * otherwise, every vertex not reached yet checking if one of its outgoing neighbors is.
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param USE_ONB if true, onb is used for the bottom up levels, otherwise it is ignored
+ * @param vleft the vertices left
+ * @param source the vertex to start from, the one that gave its color
+ * @param SCC_id the SCC id of each vertex, the vertices reached get SCC_count
+ * @param SCC_count the SCC id of this BFS
+ * @param colors the color of each vertex
+ * @param color the color of the vertices to visit
+ * @return (void)
+ */
+template <typename Matrix>
+void bfs_colors_parallel(const Matrix& inb, const Matrix& onb, const bool USE_ONB, const Numa_vector<typename Matrix::Vertex>& vleft,
+                         const size_t source, Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count,
+                         const Numa_vector<typename Matrix::Vertex>& colors, const size_t color) {
+    using Vertex = typename Matrix::Vertex;
+
+    auto claim = [&](size_t u) {
+        Vertex expected = UNCOMPLETED_SCC_ID;
+        return std::atomic_ref<Vertex>(SCC_id[u]).compare_exchange_strong(expected, SCC_count, std::memory_order_relaxed);
+    };
+
+    SCC_id[source] = SCC_count;
+    std::vector<Vertex> frontier(1, source);
+    std::vector<std::vector<Vertex>> found;
+
+    // the vertices of the color not reached yet and their outgoing edges, only kept up to date for the bottom up levels
+    std::vector<Vertex> unreached;
+    size_t unreached_edges = 0;
+    if(USE_ONB) {
+        collect_parallel(vleft, unreached, found, [&](size_t u, auto keep) {
+            if(colors[u] == color && u != source) keep(u);
+        });
+        unreached_edges = degree_sum(onb, unreached);
+    }
+
+    while(!frontier.empty()) {
+        if(USE_ONB && degree_sum(inb, frontier) > unreached_edges / PUSH_PULL_ALPHA) {
+            collect_parallel(unreached, unreached, found, [&](size_t u, auto keep) {
+                if(load_relaxed(SCC_id[u]) == UNCOMPLETED_SCC_ID) keep(u);
+            });
+            collect_parallel(unreached, frontier, found, [&](size_t u, auto keep) {
+                for(const size_t w : onb.neighbors(u)) {
+                    if(load_relaxed(SCC_id[w]) == SCC_count) {
+                        if(claim(u)) keep(u);
+                        break;
+                    }
+                }
+            });
+        } else {
+            collect_parallel(frontier, frontier, found, [&](size_t v, auto keep) {
+                for(const size_t u : inb.neighbors(v)) {
+                    if(colors[u] == color && load_relaxed(SCC_id[u]) == UNCOMPLETED_SCC_ID && claim(u)) keep(u);
+                }
+            });
+        }
+        if(USE_ONB) unreached_edges -= std::min(unreached_edges, degree_sum(onb, frontier));
+    }
+}
+
+/**
+ * @brief The hybrid BFS scheduling: the colors with at least PARALLEL_BFS_MIN_VERTICES vertices get bfs_colors_parallel,
+ * one after the other with all the workers, and are removed from unique_colors, so the small colors left keep the serial
+ * BFS, one per worker
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param USE_ONB if true, onb is used, otherwise it is ignored
+ * @param vleft the vertices left
+ * @param unique_colors the colors of this iteration, the giant ones are removed
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far, the giant colors get the ids after it
+ * @param colors the color of each vertex
+ * @param color_size the size of each color, expected to be all zero, left all zero
+ * @return the number of giant colors
+ */
+template <typename Matrix>
+size_t bfsGiantColors_inplace(const Matrix& inb, const Matrix& onb, const bool USE_ONB, const Numa_vector<typename Matrix::Vertex>& vleft,
+                              std::vector<typename Matrix::Vertex>& unique_colors, Numa_vector<typename Matrix::Vertex>& SCC_id,
+                              const size_t SCC_count, const Numa_vector<typename Matrix::Vertex>& colors,
+                              Numa_vector<typename Matrix::Vertex>& color_size) {
+    using Vertex = typename Matrix::Vertex;
+    if(vleft.size() < PARALLEL_BFS_MIN_VERTICES) return 0;
+
+    // the vertices next to each other in vleft often share their color, so every block adds the runs of one color at once
+    const size_t blocks = num_workers();
+    parallel_for(0, blocks, [&](size_t b) {
+        Vertex run_color = MAX_COLOR;
+        size_t run = 0;
+        for(size_t k = b * vleft.size() / blocks; k < (b + 1) * vleft.size() / blocks; k++) {
+            const Vertex color = colors[vleft[k]];
+            if(color != run_color) {
+                if(run > 0) std::atomic_ref<Vertex>(color_size[run_color]).fetch_add(run, std::memory_order_relaxed);
+                run_color = color;
+                run = 0;
+            }
+            run++;
         }
+        if(run > 0) std::atomic_ref<Vertex>(color_size[run_color]).fetch_add(run, std::memory_order_relaxed);
+    });
+
+    const auto small = std::stable_partition(unique_colors.begin(), unique_colors.end(), [&](Vertex color) {
+        return color_size[color] >= PARALLEL_BFS_MIN_VERTICES;
+    });
+    parallel_for(0, unique_colors.size(), [&](size_t i) {
+        color_size[unique_colors[i]] = 0;
+    });
+
+    const size_t giants = small - unique_colors.begin();
+    for(size_t i = 0; i < giants; i++) {
+        bfs_colors_parallel(inb, onb, USE_ONB, vleft, unique_colors[i], SCC_id, SCC_count + i + 1, colors, unique_colors[i]);
     }
+    unique_colors.erase(unique_colors.begin(), small);
+    return giants;
+}
+
+/**
+ * @brief The state of the worklist trim: for every vertex left, the number of its incoming and outgoing edges from
+ * other vertices left, self loops aside. When a vertex gets an SCC id its neighbors lose an edge each, and a vertex is
+ * trimmed as soon as one of its counts reaches zero, so the trim costs the edges removed instead of a scan of all the
+ * edges left every iteration.
+ */
+template <typename VertexT>
+struct Live_degrees {
+    Numa_vector<VertexT> in;
+    Numa_vector<VertexT> out;
+    // set once a vertex is queued for the trim, so it is queued once when both of its counts reach zero
+    Numa_vector<char> queued;
+
+    Live_degrees(const size_t n) : in(n), out(n), queued(n) {}
+};
+
+/**
+ * @brief Queues v for the worklist trim, unless it is queued already
+ * @return true if this call queued it
+ */
+template <typename VertexT>
+bool queue_for_trim(Live_degrees<VertexT>& live, const size_t v) {
+    std::atomic_ref<char> flag(live.queued[v]);
+    return !flag.load(std::memory_order_relaxed) && !flag.exchange(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Counts the live degrees of the vertices left, from scratch
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param vleft the vertices left, none of them trimmed yet
+ * @param SCC_id the SCC id of each vertex
+ * @param live the counts, set for the vertices of vleft
+ * @return the vertices already without incoming or outgoing live edges, queued for trimWorklist_inplace
+ */
+template <typename Matrix>
+std::vector<typename Matrix::Vertex> countLiveDegrees(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                                      const Numa_vector<typename Matrix::Vertex>& SCC_id, Live_degrees<typename Matrix::Vertex>& live) {
+    using Vertex = typename Matrix::Vertex;
+
+    auto live_count = [&](const Matrix& nb, const size_t v) {
+        Vertex count = 0;
+        for(const size_t u : nb.neighbors(v)) {
+            count += u != v && SCC_id[u] == UNCOMPLETED_SCC_ID;
+        }
+        return count;
+    };
+
+    std::vector<Vertex> queue;
+    std::vector<std::vector<Vertex>> found;
+    collect_parallel(vleft, queue, found, [&](size_t v, auto keep) {
+        live.in[v] = live_count(inb, v);
+        live.out[v] = live_count(onb, v);
+        if((live.in[v] == 0 || live.out[v] == 0) && queue_for_trim(live, v)) keep(v);
+    });
+    return queue;
+}
+
+/**
+ * @brief Takes the edges of the removed vertices out of the live degrees of their neighbors
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param removed vertices that got an SCC id since their edges were last counted, each one given once
+ * @param SCC_id the SCC id of each vertex
+ * @param live the counts
+ * @return the neighbors left without incoming or outgoing live edges, queued for trimWorklist_inplace
+ */
+template <typename Matrix>
+std::vector<typename Matrix::Vertex> releaseNeighbors(const Matrix& inb, const Matrix& onb, const std::vector<typename Matrix::Vertex>& removed,
+                                                      const Numa_vector<typename Matrix::Vertex>& SCC_id, Live_degrees<typename Matrix::Vertex>& live) {
+    using Vertex = typename Matrix::Vertex;
+
+    std::vector<Vertex> queue;
+    std::vector<std::vector<Vertex>> found;
+    collect_parallel(removed, queue, found, [&](size_t v, auto keep) {
+        // v loses an outgoing edge of its incoming neighbors and an incoming edge of its outgoing ones
+        for(const size_t u : onb.neighbors(v)) {
+            if(u == v || SCC_id[u] != UNCOMPLETED_SCC_ID) continue;
+            if(std::atomic_ref<Vertex>(live.in[u]).fetch_sub(1, std::memory_order_relaxed) == 1 && queue_for_trim(live, u)) keep(u);
+        }
+        for(const size_t u : inb.neighbors(v)) {
+            if(u == v || SCC_id[u] != UNCOMPLETED_SCC_ID) continue;
+            if(std::atomic_ref<Vertex>(live.out[u]).fetch_sub(1, std::memory_order_relaxed) == 1 && queue_for_trim(live, u)) keep(u);
+        }
+    });
+    return queue;
+}
+
+/**
+ * @brief The worklist trim: trims the queued vertices, then the neighbors they leave without incoming or outgoing live
+ * edges, and so on to the fixpoint, in one pass over the edges of the trimmed vertices. Changes SCC_IDs, does not
+ * change vleft.
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param queue the vertices to trim first, from countLiveDegrees or releaseNeighbors
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far, the trimmed vertices get the ids after it
+ * @param live the counts, kept up to date
+ * @return the number of trimmed vertices
+ */
+template <typename Matrix>
+size_t trimWorklist_inplace(const Matrix& inb, const Matrix& onb, std::vector<typename Matrix::Vertex> queue,
+                            Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count, Live_degrees<typename Matrix::Vertex>& live) {
+    size_t trimed = 0;
+    while(!queue.empty()) {
+        // the ids are set before the edges are released, so the vertices of the same level do not count each other
+        auto assign = [&](size_t k) { SCC_id[queue[k]] = SCC_count + trimed + k + 1; };
+        if(queue.size() < PARALLEL_FRONTIER_MIN) {
+            for(size_t k = 0; k < queue.size(); k++) assign(k);
+        } else {
+            parallel_for(0, queue.size(), assign);
+        }
+        trimed += queue.size();
+        queue = releaseNeighbors(inb, onb, queue, SCC_id, live);
+    }
+    return trimed;
+}
+
+/**
+ * @brief The counters of the coloring modes, for the debug output
+ */
+struct Coloring_stats {
+    // the sweeps of the frontier coloring that went over all of vleft, and the ones that pushed
+    size_t dense_sweeps = 0;
+    size_t push_sweeps = 0;
+    // the passes of shortcutColors_inplace, the sweeps they save show in Total tries against a run without --shortcut
+    size_t shortcut_passes = 0;
+};
+
+/**
+ * @brief The shortcut step of the coloring: every vertex takes the color of the vertex its color names, when smaller,
+ * as in the pointer jumping of Shiloach-Vishkin. The color of a vertex is always a vertex that reaches it, and what
+ * reaches that vertex reaches this one too, so the colors stay correct for directed reachability: they only get to the
+ * smallest vertex that reaches them in fewer sweeps. Repeated while it lowers a color.
+ * @param vertices the vertices to jump, all of vleft or the ones a sparse sweep changed
+ * @param colors the color of each vertex
+ * @param passes counts the passes over vleft
+ * @return the vertices whose color was lowered, once per pass that lowered it
+ */
+template <typename VertexT, typename Vertices>
+std::vector<VertexT> shortcutColors_inplace(const Vertices& vertices, Numa_vector<VertexT>& colors, size_t& passes) {
+    std::vector<VertexT> lowered;
+    std::vector<VertexT> pass;
+    std::vector<std::vector<VertexT>> found;
+    do {
+        passes++;
+        collect_parallel(vertices, pass, found, [&](size_t u, auto keep) {
+            const VertexT color = load_relaxed(colors[u]);
+            if(atomic_fetch_min(colors[u], load_relaxed(colors[color]))) keep(u);
+        });
+        lowered.insert(lowered.end(), pass.begin(), pass.end());
+    } while(!pass.empty());
+    return lowered;
+}
+
+/**
+ * @brief The coloring of colorSCC_no_conversion, propagating the smallest color through the incoming edges until no
+ * color changes, with sweeps that only visit the vertices that may change. A sweep keeps the list of the vertices whose
+ * color dropped. When it is long the next sweep goes over all of vleft, as the plain coloring does, when it is short
+ * the next sweep only visits the outgoing neighbors of these vertices, found through onb.
+ *
+ * With push, the short sweeps push the colors of the changed vertices to their outgoing neighbors with an atomic min
+ * instead, and the direction is chosen as in the direction optimizing BFS of Beamer et al.: push while the outgoing
+ * edges of the changed vertices are fewer than 1 / PUSH_PULL_ALPHA of the edges into vleft, pull over vleft otherwise.
+ * With the shortcuts, every sweep that changed a color is followed by shortcutColors_inplace, on the changed vertices
+ * only after a sparse sweep.
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param vleft the vertices left
+ * @param colors the color of each vertex, MAX_COLOR for the removed ones
+ * @param queued the flags that keep a vertex once in the frontier, expected to be all false, left all false
+ * @param options PUSH_PULL to push the colors of the short sweeps, SHORTCUT to jump the colors after every sweep
+ * @param stats the counters of the sweeps
+ * @return the number of sweeps
+ */
+template <typename Matrix>
+size_t colorFrontier_inplace(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                             Numa_vector<typename Matrix::Vertex>& colors, Numa_vector<char>& queued, const Scc_options& options,
+                             Coloring_stats& stats) {
+    using Vertex = typename Matrix::Vertex;
+    const bool push = options.PUSH_PULL;
+
+    // every vertex is visited by one block only, but its color is read by the others in the same sweep
+    auto pull = [&](size_t u, auto keep) {
+        Vertex color = load_relaxed(colors[u]);
+        for(const size_t v : inb.neighbors(u)) {
+            color = std::min(color, load_relaxed(colors[v]));
+        }
+        if(atomic_fetch_min(colors[u], color)) keep(u);
+    };
+
+    // claims w for the list of the next sweep, only the block that sets the flag keeps it
+    auto queue_once = [&](size_t w, auto keep) {
+        std::atomic_ref<char> flag(queued[w]);
+        if(!flag.load(std::memory_order_relaxed) && !flag.exchange(true, std::memory_order_relaxed)) {
+            keep(w);
+        }
+    };
+    auto clear_queued = [&](const std::vector<Vertex>& list) {
+        parallel_for(0, list.size(), [&](size_t k) {
+            queued[list[k]] = false;
+        });
+    };
+
+    // the colors of the neighbors drop concurrently, so they are lowered and read atomically
+    auto push_color = [&](size_t u, auto keep) {
+        const Vertex color = load_relaxed(colors[u]);
+        for(const size_t w : onb.neighbors(u)) {
+            if(load_relaxed(colors[w]) == MAX_COLOR) continue;
+            if(atomic_fetch_min(colors[w], color)) queue_once(w, keep);
+        }
+    };
+
+    const size_t vleft_edges = push ? degree_sum(inb, vleft) : 0;
+
+    std::vector<Vertex> frontier;
+    std::vector<Vertex> changed;
+    std::vector<std::vector<Vertex>> found;
+    size_t sweeps = 0;
+    bool dense = true;
+    while(true) {
+        sweeps++;
+        if(dense) {
+            stats.dense_sweeps++;
+            collect_parallel(vleft, changed, found, pull);
+        } else if(push) {
+            stats.push_sweeps++;
+            collect_parallel(changed, changed, found, push_color);
+            clear_queued(changed);
+        } else {
+            collect_parallel(frontier, changed, found, pull);
+        }
+
+        if(changed.empty()) break;
+        if(options.SHORTCUT) {
+            // a pass over vleft costs as much as a sparse sweep, so after one only the changed vertices jump. The
+            // vertices the jumps lowered changed color too.
+            const std::vector<Vertex> lowered = dense ? shortcutColors_inplace(vleft, colors, stats.shortcut_passes)
+                                                      : shortcutColors_inplace(changed, colors, stats.shortcut_passes);
+            changed.insert(changed.end(), lowered.begin(), lowered.end());
+        }
+        if(push) {
+            dense = degree_sum(onb, changed) > vleft_edges / PUSH_PULL_ALPHA;
+            continue;
+        }
+        dense = changed.size() > vleft.size() / DENSE_FRONTIER_DIVISOR;
+        if(dense) continue;
+
+        collect_parallel(changed, frontier, found, [&](size_t u, auto keep) {
+            for(const size_t w : onb.neighbors(u)) {
+                if(load_relaxed(colors[w]) != MAX_COLOR) queue_once(w, keep);
+            }
+        });
+        clear_queued(frontier);
+    }
+    return sweeps;
+}
+
+/**
+ * @brief The distinct live neighbors of v other than v itself, up to max_count of them
+ * @param nb neighbors
+ * @param v the vertex
+ * @param SCC_id the SCC id of each vertex, the live ones have UNCOMPLETED_SCC_ID
+ * @param found where the neighbors are placed, room for max_count
+ * @param max_count the most neighbors looked for
+ * @return the number of neighbors, max_count + 1 if there are more
+ */
+template <typename Matrix>
+size_t live_neighbors(const Matrix& nb, const size_t v, const Numa_vector<typename Matrix::Vertex>& SCC_id, size_t* found, const size_t max_count) {
+    using Vertex = typename Matrix::Vertex;
+
+    size_t count = 0;
+    for(const size_t u : nb.neighbors(v)) {
+        if(u == v || load_relaxed(SCC_id[u]) != UNCOMPLETED_SCC_ID || std::find(found, found + count, u) != found + count) continue;
+        if(count == max_count) return max_count + 1;
+        found[count++] = u;
+    }
+    return count;
+}
+
+/**
+ * @brief Trim2: finds the pairs of live vertices that are each other's only live neighbor in nb. With incoming
+ * neighbors nothing else enters the pair, with outgoing ones nothing leaves it, and either way the two edges between
+ * them make the pair an SCC. Every pair is assigned by its smaller vertex. Assumes that the SCC_id of the trimmed
+ * vertices is already set, does not change vleft.
+ * @param nb neighbors, incoming or outgoing
+ * @param vleft the vertices left, some may be trimmed already
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far, the pairs get the ids after it
+ * @return the number of pairs found
+ */
+template <typename Matrix>
+size_t trimPairs_inplace(const Matrix& nb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                         Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) {
+    using Vertex = typename Matrix::Vertex;
+    std::atomic<size_t> pairs(0);
+
+    parallel_for(0, vleft.size(), [&](size_t index) {
+        const size_t v = vleft[index];
+        size_t u, w;
+        if(load_relaxed(SCC_id[v]) != UNCOMPLETED_SCC_ID || live_neighbors(nb, v, SCC_id, &u, 1) != 1 || u < v) return;
+        if(live_neighbors(nb, u, SCC_id, &w, 1) != 1 || w != v) return;
+
+        const size_t id = SCC_count + ++pairs;
+        store_relaxed(SCC_id[v], id);
+        store_relaxed(SCC_id[u], id);
+    });
+
+    return pairs;
+}
+
+/**
+ * @brief Trim3: finds the sets of three live vertices whose live neighbors in nb are all inside the set, and whose
+ * edges make the set strongly connected, a 3-cycle with or without chords. Such a set is closed, so it is an SCC.
+ * The set is built from its smallest vertex v: either v and its two neighbors, or v, its one neighbor u and the one
+ * neighbor of u other than v. Assumes that the SCC_id of the trimmed vertices is already set, does not change vleft.
+ * @param nb neighbors, incoming or outgoing
+ * @param vleft the vertices left, some may be trimmed already
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far, the sets get the ids after it
+ * @return the number of sets found
+ */
+template <typename Matrix>
+size_t trimTriples_inplace(const Matrix& nb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                           Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count) {
+    using Vertex = typename Matrix::Vertex;
+    std::atomic<size_t> triples(0);
+
+    parallel_for(0, vleft.size(), [&](size_t index) {
+        const size_t v = vleft[index];
+        if(load_relaxed(SCC_id[v]) != UNCOMPLETED_SCC_ID) return;
+
+        size_t set[3] = {v, 0, 0};
+        size_t found[2];
+        const size_t count = live_neighbors(nb, v, SCC_id, found, 2);
+        if(count == 2) {
+            set[1] = found[0];
+            set[2] = found[1];
+        } else if(count == 1) {
+            set[1] = found[0];
+            size_t next[2];
+            const size_t next_count = live_neighbors(nb, found[0], SCC_id, next, 2);
+            if(next_count == 2 && (next[0] == v || next[1] == v)) {
+                set[2] = next[0] == v ? next[1] : next[0];
+            } else if(next_count == 1 && next[0] != v) {
+                set[2] = next[0];
+            } else {
+                return;
+            }
+        } else {
+            return;
+        }
+        if(set[1] < v || set[2] < v) return;
+
+        // edge[a] has bit b set if set[b] is a neighbor of set[a]
+        unsigned edge[3] = {0, 0, 0};
+        for(size_t a = 0; a < 3; a++) {
+            size_t neighbors[2];
+            const size_t neighbor_count = live_neighbors(nb, set[a], SCC_id, neighbors, 2);
+            if(neighbor_count > 2) return;
+            for(size_t k = 0; k < neighbor_count; k++) {
+                const size_t b = std::find(set, set + 3, neighbors[k]) - set;
+                if(b == 3) return;
+                edge[a] |= 1u << b;
+            }
+        }
+
+        // strongly connected: set[0] reaches the other two, and both reach it, two steps are enough for three vertices
+        unsigned reach = 1, reached_by = 1;
+        for(size_t step = 0; step < 2; step++) {
+            for(size_t a = 0; a < 3; a++) {
+                if(reach & (1u << a)) reach |= edge[a];
+                if(edge[a] & reached_by) reached_by |= 1u << a;
+            }
+        }
+        if(reach != 7 || reached_by != 7) return;
+
+        const size_t id = SCC_count + ++triples;
+        for(const size_t x : set) {
+            store_relaxed(SCC_id[x], id);
+        }
+    });
+
+    return triples;
+}
+
+/**
+ * @brief The trims of SCCs of size 2 and 3 the options ask for, after the trim of single vertices: Trim2 and then
+ * Trim3, through the incoming neighbors and, when onb is used, the outgoing ones
+ * @param inb incoming neighbors
+ * @param onb outgoing neighbors
+ * @param USE_ONB if true, onb is used, otherwise it is ignored
+ * @param vleft the vertices left, some may be trimmed already
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far
+ * @param options the trims to do
+ * @param pairs_found the SCCs of size 2 found so far, for the debug output
+ * @param triples_found the SCCs of size 3 found so far, for the debug output
+ * @return the number of SCCs found
+ */
+template <typename Matrix>
+size_t trimSmallSCCs_inplace(const Matrix& inb, const Matrix& onb, const bool USE_ONB, const Numa_vector<typename Matrix::Vertex>& vleft,
+                             Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count, const Scc_options& options,
+                             size_t& pairs_found, size_t& triples_found) {
+    size_t found = 0;
+    if(options.TRIM2) {
+        size_t pairs = trimPairs_inplace(inb, vleft, SCC_id, SCC_count + found);
+        if(USE_ONB) pairs += trimPairs_inplace(onb, vleft, SCC_id, SCC_count + found + pairs);
+        pairs_found += pairs;
+        found += pairs;
+    }
+    if(options.TRIM3) {
+        size_t triples = trimTriples_inplace(inb, vleft, SCC_id, SCC_count + found);
+        if(USE_ONB) triples += trimTriples_inplace(onb, vleft, SCC_id, SCC_count + found + triples);
+        triples_found += triples;
+        found += triples;
+    }
+    return found;
+}
+
+/**
+ * @brief The subgraph induced by the vertices left, renumbered in the order of vleft and with only the edges between
+ * them, so the late iterations sweep short lists in a small address range instead of the lists of the whole graph
+ * @param nb incoming or outgoing neighbors
+ * @param vleft the vertices left, vleft[i] becomes vertex i of the subgraph
+ * @param local_id the new id of every vertex of vleft, the others are not read
+ * @param SCC_id the SCC id of each vertex, only the neighbors with UNCOMPLETED_SCC_ID are kept
+ * @return the subgraph, a Sparse_matrix even for a Compressed_matrix, with the offset type of nb
+ */
+template <typename Matrix>
+Sparse_matrix<typename Matrix::Vertex, typename Matrix::Offset> inducedSubgraph(const Matrix& nb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                                                                const Numa_vector<typename Matrix::Vertex>& local_id,
+                                                                                const Numa_vector<typename Matrix::Vertex>& SCC_id) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+    using Subgraph = Sparse_matrix<Vertex, Offset>;
+    const size_t m = vleft.size();
+
+    // first pass: the live edges of every vertex, then where its list starts
+    Numa_vector<Offset> ptr(m + 1);
+    parallel_for(0, m, [&](size_t i) {
+        Offset live_edges = 0;
+        for(const size_t w : nb.neighbors(vleft[i])) {
+            live_edges += SCC_id[w] == UNCOMPLETED_SCC_ID ? 1 : 0;
+        }
+        ptr[i] = live_edges;
+    });
+    const size_t nnz = parallel_exclusive_scan(ptr.data(), m + 1);
+
+    // second pass: the live neighbors in their new ids, vleft is in vertex order so the lists stay sorted
+    Numa_vector<Vertex> val(nnz);
+    parallel_for(0, m, [&](size_t i) {
+        size_t out = ptr[i];
+        for(const size_t w : nb.neighbors(vleft[i])) {
+            if(SCC_id[w] == UNCOMPLETED_SCC_ID) {
+                val[out++] = local_id[w];
+            }
+        }
+    });
+
+    Subgraph sub;
+    sub.n = m;
+    sub.nnz = nnz;
+    sub.ptr = Index_array<Offset>(std::move(ptr));
+    sub.val = Index_array<Vertex>(std::move(val));
+    sub.type = nb.type == Matrix::CSC ? Subgraph::CSC : Subgraph::CSR;
+    return sub;
+}
+
+/**
+ * @brief Gives the vertices left the SCCs found in their induced subgraph, after the ones found so far
+ * @param vleft the vertices left, vleft[i] is vertex i of the subgraph
+ * @param sub_SCC_id the SCC id of each vertex of the subgraph, from 1 to its number of SCCs
+ * @param SCC_id the SCC id of each vertex
+ * @param SCC_count the number of SCCs found so far
+ * @return the largest SCC id of the subgraph, its number of SCCs
+ */
+template <typename VertexT>
+size_t mapSubgraphSCCs(const Numa_vector<VertexT>& vleft, const Numa_vector<VertexT>& sub_SCC_id, Numa_vector<VertexT>& SCC_id,
+                       const size_t SCC_count) {
+    const size_t m = vleft.size();
+    const size_t blocks = std::min(num_workers(), m / 4096 + 1);
+
+    std::vector<size_t> block_max(blocks, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        size_t largest = 0;
+        for(size_t i = b * m / blocks; i < (b + 1) * m / blocks; i++) {
+            SCC_id[vleft[i]] = SCC_count + sub_SCC_id[i];
+            largest = std::max<size_t>(largest, sub_SCC_id[i]);
+        }
+        block_max[b] = largest;
+    });
+
+    return *std::max_element(block_max.begin(), block_max.end());
 }
 
 /**
@@ -296,22 +1165,35 @@ void coloring_partitions_runner(coloring_partitions_runner_struct* coloring_info
  * @param DEBUG if true, prints debug info
  * @return the SCC id of each vertex
  */
-std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Sparse_matrix& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS) {
+template <typename Matrix>
+Numa_vector<typename Matrix::Vertex> colorSCC_no_conversion(const Matrix& inb, const Matrix& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS,
+                                                             const First_trim<typename Matrix::Vertex>* first_trim, const Scc_options& options) {
+    using Vertex = typename Matrix::Vertex;
 
     size_t n = inb.n;
-    std::vector<size_t> SCC_id(n, UNCOMPLETED_SCC_ID);
+    // made untouched and filled by the same equal partitions the coloring threads get, so every thread finds
+    // its part of the per vertex arrays on its own NUMA node
+    Numa_vector<Vertex> SCC_id(n);
     size_t SCC_count = 0;
 
     // an array of vertices that are left to be processed
     DEB("Starting trim")
-    std::vector<size_t> vleft(n);
-    for (size_t i = 0; i < n; i++) {
+    Numa_vector<Vertex> vleft(n);
+    parallel_for(0, n, [&](size_t i) {
+        SCC_id[i] = first_trim != nullptr ? first_trim->SCC_id[i] : UNCOMPLETED_SCC_ID;
         vleft[i] = i;
-    }
+    });
+
 
+    // the other half of the double buffer vleft is compacted into, every erasure swaps the two
+    Numa_vector<Vertex> vleft_buffer;
+    auto uncompleted = [&](size_t v) { return SCC_id[v] == UNCOMPLETED_SCC_ID; };
 
     DEB("First time trim")
-    if(USE_ONB) {
+    if(first_trim != nullptr) {
+        // done from the degrees while the graph was loading, SCC_id is already set above
+        SCC_count += first_trim->count;
+    } else if(USE_ONB) {
         SCC_count += trimVertices_inplace_first_time(inb, onb, SCC_id, SCC_count);
     } else {
         SCC_count += trimVertices_inplace_first_time_single_direction(inb, SCC_id, SCC_count);
@@ -320,70 +1202,170 @@ std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Spars
 
     // remove all vertices that have been trimmed
     DEB("First erasure")
-    std::erase_if(vleft, [&](size_t v) { return SCC_id[v] != UNCOMPLETED_SCC_ID; });
+    parallel_filter(vleft, vleft_buffer, uncompleted);
     DEB("Finished first erasure")
     DEB("Size difference: " << SCC_count)
 
-    std::vector<size_t> colors(n);
+    // the worklist trim keeps the live degrees from here on, and takes the chains the first trim left to the fixpoint
+    const bool WORKLIST_TRIM = options.WORKLIST_TRIM && USE_ONB;
+    Live_degrees<Vertex> live(WORKLIST_TRIM ? n : 0);
+    if(WORKLIST_TRIM) {
+        const size_t trimmed = trimWorklist_inplace(inb, onb, countLiveDegrees(inb, onb, vleft, SCC_id, live), SCC_id, SCC_count, live);
+        SCC_count += trimmed;
+        parallel_filter(vleft, vleft_buffer, uncompleted);
+        DEB("Worklist trim: " << trimmed << " vertices")
+    }
+
+    // removes the vertices that got an SCC id from vleft. With the worklist trim they release their neighbors first,
+    // and the vertices left without live edges on one side are trimmed, to the fixpoint
+    auto erase_and_release = [&]() {
+        size_t trimmed = 0;
+        if(WORKLIST_TRIM) {
+            std::vector<Vertex> removed;
+            parallel_copy_if(vleft, removed, [&](size_t v) { return SCC_id[v] != UNCOMPLETED_SCC_ID; });
+            parallel_filter(vleft, vleft_buffer, uncompleted);
+            trimmed = trimWorklist_inplace(inb, onb, releaseNeighbors(inb, onb, removed, SCC_id, live), SCC_id, SCC_count, live);
+            SCC_count += trimmed;
+        }
+        parallel_filter(vleft, vleft_buffer, uncompleted);
+        return trimmed;
+    };
+
+    size_t pairs_found = 0, triples_found = 0;
+    if(options.TRIM2 || options.TRIM3) {
+        SCC_count += trimSmallSCCs_inplace(inb, onb, USE_ONB, vleft, SCC_id, SCC_count, options, pairs_found, triples_found);
+        erase_and_release();
+        DEB("First Trim2/Trim3: " << pairs_found << " SCCs of size 2, " << triples_found << " of size 3")
+    }
+
+    if(options.FW_BW && USE_ONB) {
+        DEB("FW-BW pivot phase")
+        const size_t pivot_SCC_size = fwbwPivot(inb, onb, vleft, SCC_id, SCC_count);
+        SCC_count++;
+        DEB("The SCC of the pivot has " << pivot_SCC_size << " vertices")
+
+        // without the giant SCC many vertices are left with neighbors on one side only
+        if(WORKLIST_TRIM) {
+            erase_and_release();
+        } else {
+            parallel_filter(vleft, vleft_buffer, uncompleted);
+            SCC_count += trimVertices_inplace(inb, onb, vleft, SCC_id, SCC_count);
+            parallel_filter(vleft, vleft_buffer, uncompleted);
+        }
+        DEB("Finished FW-BW, " << vleft.size() << " vertices left")
+    }
+
+    Numa_vector<Vertex> colors(n);
+
+    // the flags of the frontier coloring, which needs onb to find the vertices that see a dropped color
+    const bool FRONTIER_COLORING = (options.FRONTIER_COLORING || options.PUSH_PULL) && USE_ONB;
+    Numa_vector<char> queued(FRONTIER_COLORING ? n : 0);
+    // the color sizes of the hybrid BFS
+    Numa_vector<Vertex> color_size(options.PARALLEL_BFS ? n : 0);
+    Coloring_stats stats;
+
+    // the trims and the coloring sweep the lists in vertex order, the BFS jumps around
+    inb.advise(ACCESS_SEQUENTIAL);
+    if(USE_ONB) onb.advise(ACCESS_SEQUENTIAL);
 
     size_t iter = 0;
     size_t total_tries = 0;
+
+    // the colors of every iteration, kept between the iterations so their memory is reused
+    std::vector<Vertex> unique_colors;
+    std::vector<std::vector<Vertex>> color_blocks;
     while(!vleft.empty()) {
+        // most vertices have their SCC: the rest of the algorithm runs on the subgraph of the vertices left, which is
+        // built again inside once few of its own vertices are left
+        if(options.COMPACT && vleft.size() < n / COMPACT_LIVE_DIVISOR) {
+            Numa_vector<Vertex> local_id(n);
+            parallel_for(0, vleft.size(), [&](size_t i) { local_id[vleft[i]] = i; });
+
+            using Subgraph = Sparse_matrix<Vertex, typename Matrix::Offset>;
+            const Subgraph sub_inb = inducedSubgraph(inb, vleft, local_id, SCC_id);
+            const Subgraph sub_onb = USE_ONB ? inducedSubgraph(onb, vleft, local_id, SCC_id) : Subgraph();
+            DEB("Compacted to the subgraph of the " << sub_inb.n << " vertices left, " << sub_inb.nnz << " of " << inb.nnz << " edges")
+
+            const Numa_vector<Vertex> sub_SCC_id = colorSCC_no_conversion(sub_inb, sub_onb, USE_ONB, DEBUG, NUM_THREADS, nullptr, options);
+            SCC_count += mapSubgraphSCCs(vleft, sub_SCC_id, SCC_id, SCC_count);
+            DEB("Finished the subgraph")
+            break;
+        }
+
         iter++;
         DEB("Starting while loop iteration " << iter)
 
         // the removed vertices are colored MAX_COLOR, this color never gets propagated to other vertices
-        for(size_t i = 0; i < n; i++) {
+        parallel_for(0, n, [&](size_t i) {
             colors[i] = SCC_id[i] == UNCOMPLETED_SCC_ID ? i : MAX_COLOR;
-        }
+        });
 
         DEB("Starting to color")
-        bool made_change = true;
-        while(made_change) {
-            made_change = false;
-
-            const size_t num_vertices = vleft.size();
+        const size_t tries_before = total_tries;
+        if(FRONTIER_COLORING) {
+            total_tries += colorFrontier_inplace(inb, onb, vleft, colors, queued, options, stats);
+        } else {
+            bool made_change = true;
+            while(made_change) {
+                total_tries++;
+                const size_t num_vertices = vleft.size();
 
-            // Each thread gets at least COLOR_GRAIN_SIZE vertices to color
-            // we may not use all threads
-            size_t threads_to_use = (num_vertices/COLOR_GRAIN_SIZE <= 1) ? 1 : 
-                                    (num_vertices/COLOR_GRAIN_SIZE > NUM_THREADS) ? NUM_THREADS : 1;
+                // Each thread gets at least COLOR_GRAIN_SIZE vertices to color
+                // we may not use all threads
+                size_t threads_to_use = (num_vertices/COLOR_GRAIN_SIZE <= 1) ? 1 : 
+                                        (num_vertices/COLOR_GRAIN_SIZE > NUM_THREADS) ? NUM_THREADS : 1;
 
-            DEB("Using " << threads_to_use << " threads for coloring.")
+                DEB("Using " << threads_to_use << " threads for coloring.")
 
-            std::vector<pthread_t> threads(threads_to_use);
-            std::vector<coloring_partitions_runner_struct> coloring_info(threads_to_use);
+                std::vector<pthread_t> threads(threads_to_use);
+                std::vector<coloring_partitions_runner_struct<Matrix>> coloring_info(threads_to_use);
+                std::vector<Change_flag> changed(threads_to_use);
 
-            for(size_t i = 0; i < threads_to_use; i++) {
+                for(size_t i = 0; i < threads_to_use; i++) {
 
-                // equally split partitions
-                const size_t start = i * num_vertices / threads_to_use;
-                const size_t end = (i == threads_to_use - 1) ? num_vertices : (i + 1) * num_vertices / threads_to_use;
+                    // equally split partitions
+                    const size_t start = i * num_vertices / threads_to_use;
+                    const size_t end = (i == threads_to_use - 1) ? num_vertices : (i + 1) * num_vertices / threads_to_use;
 
-                // info for each thread
-                coloring_info[i] = {&inb, &colors, &vleft, start, end, &made_change, false};
+                    // info for each thread
+                    coloring_info[i] = {&inb, &colors, &vleft, start, end, &changed[i], false};
                 
-                // a thread runs the coloring for all vertices in vleft[start:end]
-                pthread_create(&threads[i], NULL, (void*(*)(void*))coloring_partitions_runner, &coloring_info[i]);
-            }
+                    // a thread runs the coloring for all vertices in vleft[start:end]
+                    pthread_create(&threads[i], NULL, (void*(*)(void*))coloring_partitions_runner<Matrix>, &coloring_info[i]);
+                }
 
-            for(size_t i = 0; i < threads_to_use; i++) {
-                pthread_join(threads[i], NULL);
-            } 
-        }
+                for(size_t i = 0; i < threads_to_use; i++) {
+                    pthread_join(threads[i], NULL);
+                } 
+
+                made_change = std::any_of(changed.begin(), changed.end(), [](const Change_flag& flag) { return flag.changed; });
 
-        DEB("Finished coloring")
+                // jump the colors ahead before the next sweep
+                if(made_change && options.SHORTCUT) {
+                    shortcutColors_inplace(vleft, colors, stats.shortcut_passes);
+                }
+            }
+        }
+        DEB("Finished coloring in " << total_tries - tries_before << " sweeps")
 
-        // Create a set of the unique colors to schedule the BFS
+        // Collect the unique colors to schedule the BFS
         // A BFS starts from each unique color
         DEB("Set of colors part");
-        auto unique_colors_set = std::unordered_set<size_t> (colors.begin(), colors.end());
-        unique_colors_set.erase(MAX_COLOR);
-        DEB("Found " << unique_colors_set.size() << " unique colors")
-        auto unique_colors = std::vector<size_t>(unique_colors_set.begin(), unique_colors_set.end());
+        // the root of a color is the vertex that gave it, the only one with colors[v] == v: the smallest vertex that
+        // reaches a vertex also has no smaller vertex reaching itself. So the colors are the roots in vleft.
+        collect_parallel(vleft, unique_colors, color_blocks, [&](size_t v, auto keep) {
+            if(colors[v] == v) keep(v);
+        });
+        DEB("Found " << unique_colors.size() << " unique colors")
         DEB("Set of colors part");
 
         DEB("Starting bfs")
+        inb.advise(ACCESS_RANDOM);
+        if(options.PARALLEL_BFS) {
+            const size_t giants = bfsGiantColors_inplace(inb, onb, USE_ONB, vleft, unique_colors, SCC_id, SCC_count, colors, color_size);
+            SCC_count += giants;
+            DEB("Parallel BFS for " << giants << " giant colors")
+        }
 
         const size_t num_colors = unique_colors.size();
         // each thread will get a different set of colors to work on
@@ -396,7 +1378,7 @@ std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Spars
         DEB("Using " << threads_to_use << " threads for BFS")
 
         if(threads_to_use == 1) {
-            bfs_partitions_runner_struct bfs_plus_info = 
+            bfs_partitions_runner_struct<Matrix> bfs_plus_info = 
                         {&inb, &SCC_id, SCC_count, &colors, &unique_colors, 0, num_colors, false};
 
             // no need to dispatch any threads
@@ -404,7 +1386,7 @@ std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Spars
         } else {
 
             std::vector<pthread_t> threads(threads_to_use);
-            std::vector<bfs_partitions_runner_struct> bfs_plus_infos(threads_to_use);
+            std::vector<bfs_partitions_runner_struct<Matrix>> bfs_plus_infos(threads_to_use);
 
             for(size_t i = 0; i < threads_to_use; i++) {
                 // equally split partitions
@@ -414,7 +1396,7 @@ std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Spars
                 // info for each thread
                 // A thread starts a BFS from each color in unique_colors[start:end]
                 bfs_plus_infos[i] = {&inb, &SCC_id, SCC_count, &colors, &unique_colors, start, end, true};
-                pthread_create(&threads[i], NULL, (void* (*)(void*))bfs_partitions_runner, &bfs_plus_infos[i]);
+                pthread_create(&threads[i], NULL, (void* (*)(void*))bfs_partitions_runner<Matrix>, &bfs_plus_infos[i]);
             }
 
             for(size_t i = 0; i < threads_to_use; i++) {
@@ -423,21 +1405,51 @@ std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Spars
         }
         SCC_count += unique_colors.size();
         DEB("Finished BFS")
+        inb.advise(ACCESS_SEQUENTIAL);
 
-        // remove all vertices that are in some SCC
-        std::erase_if(vleft, [&](size_t v) { return SCC_id[v] != UNCOMPLETED_SCC_ID; });
-        if (USE_ONB) {
-           SCC_count += trimVertices_inplace(inb, onb, vleft, SCC_id, SCC_count);
+        if(WORKLIST_TRIM) {
+            const size_t trimmed = erase_and_release();
+            DEB("Worklist trim: " << trimmed << " vertices")
         } else {
-           SCC_count += trimVertices_inplace_single_direction(inb, vleft, SCC_id, SCC_count);
+            // remove all vertices that are in some SCC
+            parallel_filter(vleft, vleft_buffer, uncompleted);
+            if (USE_ONB) {
+               SCC_count += trimVertices_inplace(inb, onb, vleft, SCC_id, SCC_count);
+            } else {
+               SCC_count += trimVertices_inplace_single_direction(inb, vleft, SCC_id, SCC_count);
+            }
+        }
+        if(options.TRIM2 || options.TRIM3) {
+            const size_t pairs_before = pairs_found, triples_before = triples_found;
+            SCC_count += trimSmallSCCs_inplace(inb, onb, USE_ONB, vleft, SCC_id, SCC_count, options, pairs_found, triples_found);
+            DEB("Trim2 found " << pairs_found - pairs_before << " SCCs of size 2, Trim3 " << triples_found - triples_before << " of size 3")
         }
         // clean up vleft after trim
-        std::erase_if(vleft, [&](size_t v) { return SCC_id[v] != UNCOMPLETED_SCC_ID; });
+        erase_and_release();
     }
     DEB("Finished")
 
     DEB("Total tries: " << total_tries)
     DEB("Total iterations: " << iter)
     DEB("Total SCCs: " << SCC_count)
+    if(FRONTIER_COLORING) {
+        DEB("Dense sweeps of the frontier coloring: " << stats.dense_sweeps << ", push sweeps: " << stats.push_sweeps)
+    }
+    if(options.SHORTCUT) {
+        DEB("Shortcut passes: " << stats.shortcut_passes)
+    }
+    if(options.TRIM2 || options.TRIM3) {
+        DEB("Trim2 found " << pairs_found << " SCCs of size 2, Trim3 " << triples_found << " of size 3 in total")
+    }
     return SCC_id;
-}
\ No newline at end of file
+}
+
+// the index widths main can pick at load time
+template First_trim<uint32_t> trimFromDegrees(const size_t n, const uint32_t* in_ptr, const uint32_t* out_ptr);
+template First_trim<uint32_t> trimFromDegrees(const size_t n, const uint64_t* in_ptr, const uint64_t* out_ptr);
+template First_trim<uint64_t> trimFromDegrees(const size_t n, const uint64_t* in_ptr, const uint64_t* out_ptr);
+template Numa_vector<uint32_t> colorSCC_no_conversion(const Sparse_matrix_32& inb, const Sparse_matrix_32& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS, const First_trim<uint32_t>* first_trim, const Scc_options& options);
+template Numa_vector<uint32_t> colorSCC_no_conversion(const Sparse_matrix_32_64& inb, const Sparse_matrix_32_64& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS, const First_trim<uint32_t>* first_trim, const Scc_options& options);
+template Numa_vector<uint64_t> colorSCC_no_conversion(const Sparse_matrix_64& inb, const Sparse_matrix_64& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS, const First_trim<uint64_t>* first_trim, const Scc_options& options);
+template Numa_vector<uint32_t> colorSCC_no_conversion(const Compressed_matrix<uint32_t>& inb, const Compressed_matrix<uint32_t>& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS, const First_trim<uint32_t>* first_trim, const Scc_options& options);
+template Numa_vector<uint64_t> colorSCC_no_conversion(const Compressed_matrix<uint64_t>& inb, const Compressed_matrix<uint64_t>& onb, bool USE_ONB, bool DEBUG, const size_t NUM_THREADS, const First_trim<uint64_t>* first_trim, const Scc_options& options);
@@ -7,63 +7,342 @@
 #include <unordered_set>
 #include <chrono>
 #include <filesystem>
+#include <thread>
 
 #include "sparse_util.hpp"
 #include "colorSCC.hpp"
+#include "parallel_util.hpp"
 
 #define DEFAULT_PREFIX "../../matrices/"
 
-void testFile(std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size_t NUM_THREADS) {
-    if(!std::filesystem::exists(filename)) {
-        std::cout << "File not found: " << filename << std::endl;
-        return;
+/**
+ * @brief Options given as --flags, in any position of the command line
+ */
+struct Run_options {
+    // use the binary cache next to the .mtx file, making it if it is missing or older than the .mtx
+    bool USE_CACHE = true;
+    // read the whole binary cache once to check its checksum before using it
+    bool VERIFY_CACHE = false;
+    // run on gap encoded adjacency lists instead of the plain CSC/CSR
+    bool COMPRESS = false;
+    // sort the adjacency lists and remove duplicate edges after parsing
+    bool CANONICALIZE = true;
+    // remove the self loops while canonicalizing, they never change the SCCs but keep vertices from being trimmed
+    bool REMOVE_SELF_LOOPS = true;
+    // only time the loader of each file, timesToRun times, instead of running the algorithm
+    bool BENCH_LOAD = false;
+    // only time the compaction of the vertices left, parallel and serial, timesToRun times, instead of running the algorithm
+    bool BENCH_COMPACT = false;
+    // run on the CSC mapped from the binary cache, made without loading the graph into memory, for graphs larger than memory
+    bool OUT_OF_CORE = false;
+    // spread the pages of the graph and per vertex arrays over all NUMA nodes, instead of placing them by first touch
+    bool NUMA_INTERLEAVE = false;
+    // back the graph and per vertex arrays with huge pages, fewer TLB misses on the random lookups of the kernels
+    Page_size PAGE_SIZE = PAGES_NORMAL;
+    // run on the file order and again after renumbering the vertices in this order, reporting both and the cost of reordering
+    Vertex_order ORDER = ORDER_NONE;
+    // when the file is parsed: count the degrees while it is read, do the first trim while the lists are filled and
+    // write the binary caches while the algorithm runs
+    bool PIPELINE = false;
+    // the optional phases of the algorithm
+    Scc_options SCC;
+};
+
+/**
+ * @brief Parses one --flag into the options
+ * @param flag the flag, including the leading --
+ * @param options the options to change
+ * @return false if the flag is not known
+ */
+bool parseFlag(const std::string& flag, Run_options& options) {
+    if(flag == "--no-cache") {
+        options.USE_CACHE = false;
+    } else if(flag == "--verify-cache") {
+        options.VERIFY_CACHE = true;
+    } else if(flag == "--compress") {
+        options.COMPRESS = true;
+    } else if(flag == "--no-canonicalize") {
+        options.CANONICALIZE = false;
+    } else if(flag == "--keep-self-loops") {
+        options.REMOVE_SELF_LOOPS = false;
+    } else if(flag == "--bench-load") {
+        options.BENCH_LOAD = true;
+    } else if(flag == "--bench-compact") {
+        options.BENCH_COMPACT = true;
+    } else if(flag == "--out-of-core") {
+        options.OUT_OF_CORE = true;
+    } else if(flag == "--numa-interleave") {
+        options.NUMA_INTERLEAVE = true;
+    } else if(flag == "--huge-pages") {
+        options.PAGE_SIZE = PAGES_TRANSPARENT_HUGE;
+    } else if(flag == "--huge-pages=2M") {
+        options.PAGE_SIZE = PAGES_HUGETLB_2M;
+    } else if(flag == "--huge-pages=1G") {
+        options.PAGE_SIZE = PAGES_HUGETLB_1G;
+    } else if(flag == "--reorder=degree") {
+        options.ORDER = ORDER_DEGREE;
+    } else if(flag == "--reorder=rcm") {
+        options.ORDER = ORDER_RCM;
+    } else if(flag == "--reorder=gorder") {
+        options.ORDER = ORDER_GORDER;
+    } else if(flag == "--pipeline") {
+        options.PIPELINE = true;
+    } else if(flag == "--fw-bw") {
+        options.SCC.FW_BW = true;
+    } else if(flag == "--trim2") {
+        options.SCC.TRIM2 = true;
+    } else if(flag == "--trim3") {
+        options.SCC.TRIM3 = true;
+    } else if(flag == "--worklist-trim") {
+        options.SCC.WORKLIST_TRIM = true;
+    } else if(flag == "--frontier-coloring") {
+        options.SCC.FRONTIER_COLORING = true;
+    } else if(flag == "--push-pull") {
+        options.SCC.PUSH_PULL = true;
+    } else if(flag == "--shortcut") {
+        options.SCC.SHORTCUT = true;
+    } else if(flag == "--parallel-bfs") {
+        options.SCC.PARALLEL_BFS = true;
+    } else if(flag == "--compact") {
+        options.SCC.COMPACT = true;
+    } else {
+        return false;
     }
+    return true;
+}
 
-    if(times == 0) {
-        std::cout << "Invalid number of times to run" << std::endl;
+/**
+ * @brief Maps the binary cache of a matrix if it exists and is newer than the .mtx file
+ * @param binary_filename the binary cache
+ * @param filename the .mtx file it was made from
+ * @param matrix where the mapped matrix is placed
+ * @param options the run options
+ * @param DEBUG if true, prints why a cache was not used
+ * @return true if the matrix was loaded from the cache
+ */
+template <typename Matrix>
+bool tryLoadBinary(const std::string& binary_filename, const std::string& filename, Matrix& matrix, const Run_options& options, bool DEBUG) {
+    if(!options.USE_CACHE || !isBinaryUpToDate(binary_filename, filename)) {
+        return false;
+    }
+
+    try {
+        matrix = loadBinaryToSparse<Matrix>(binary_filename, options.VERIFY_CACHE);
+    } catch(const std::exception& e) {
+        DEB("Ignoring binary cache: " << e.what())
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Saves the binary cache of a matrix, a failure only means the next run parses the .mtx file again
+ * @param binary_filename the binary cache
+ * @param matrix the matrix to save
+ * @param options the run options
+ * @param DEBUG if true, prints the time it took or why it failed
+ * @return (void)
+ */
+template <typename Matrix>
+void trySaveBinary(const std::string& binary_filename, const Matrix& matrix, const Run_options& options, bool DEBUG) {
+    if(!options.USE_CACHE) return;
+
+    auto start_save = std::chrono::high_resolution_clock::now();
+    try {
+        saveSparseToBinary(matrix, binary_filename);
+    } catch(const std::exception& e) {
+        DEB("Could not save binary cache: " << e.what())
         return;
     }
+    auto end_save = std::chrono::high_resolution_clock::now();
+    DEB("Saved " << binary_filename << ", toook " << std::chrono::duration_cast<std::chrono::milliseconds>(end_save - start_save).count() << "ms")
+}
 
-    DEB("Loading file into CSC")
-    auto start_load_csc = std::chrono::high_resolution_clock::now();
-    Sparse_matrix csc = loadFileToCSC(filename);
-    auto end_load_csc = std::chrono::high_resolution_clock::now();
-    DEB("Loaded file into CSC, toook " << std::chrono::duration_cast<std::chrono::milliseconds>(end_load_csc - start_load_csc).count() << "ms")
+/**
+ * @brief The binary cache of one side of a matrix, the graphs cleaned in different ways are cached apart
+ * @param filename the .mtx file
+ * @param side "csc" or "csr"
+ * @param options the run options
+ * @return the name of the binary cache
+ */
+std::string binaryName(const std::string& filename, const std::string& side, const Run_options& options) {
+    if(!options.CANONICALIZE) return filename + ".raw." + side + ".bin";
+    if(!options.REMOVE_SELF_LOOPS) return filename + ".loops." + side + ".bin";
+    return filename + "." + side + ".bin";
+}
 
-    Sparse_matrix csr = Sparse_matrix();
-    if (TOO_BIG) {
-        DEB("File is too big, skipping CSR")
-    } else {
-        DEB("Making CSR Version")
-        auto start_load_csr = std::chrono::high_resolution_clock::now();
-        csc_tocsr(csc, csr);
-        auto end_load_csr = std::chrono::high_resolution_clock::now();
-        DEB("Making CSR, toook " << std::chrono::duration_cast<std::chrono::milliseconds>(end_load_csr - start_load_csr).count() << "ms")
+/**
+ * @brief Canonicalizes a freshly parsed matrix if the options ask for it
+ * @param matrix the matrix to clean
+ * @param options the run options
+ * @param DEBUG if true, prints the edges removed and the time it took
+ * @return (void)
+ */
+template <typename Matrix>
+void tryCanonicalize(Matrix& matrix, const Run_options& options, bool DEBUG) {
+    if(!options.CANONICALIZE) return;
+
+    auto start_canonicalize = std::chrono::high_resolution_clock::now();
+    const size_t removed = canonicalizeSparse(matrix, options.REMOVE_SELF_LOOPS);
+    auto end_canonicalize = std::chrono::high_resolution_clock::now();
+    DEB("Canonicalized " << (matrix.type == Matrix::CSC ? "CSC" : "CSR") << ", removed " << removed << " edges, toook "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(end_canonicalize - start_canonicalize).count() << "ms")
+}
+
+// "folder/eu-2005/eu-2005.mtx.gz" -> "eu-2005"
+std::string datasetName(const std::string& filename) {
+    std::string dataset_name = stripCompressionExtension(filename);
+    dataset_name = dataset_name.substr(dataset_name.find_last_of("/") + 1);
+    return dataset_name.substr(0, dataset_name.find_last_of("."));
+}
+
+/**
+ * @brief Measures the throughput of the loader of a file, for any of its formats: loads it times times, without
+ * the binary cache, into CSC and CSR (only CSC if TOO_BIG) and prints the time, MB/s and edges per second of each load
+ * @param filename the graph file
+ * @param times the number of loads
+ * @param DEBUG if true, prints debug information
+ * @param TOO_BIG if true, only the CSC is made
+ * @return (void)
+ */
+template <typename Matrix>
+void benchLoad(std::string filename, size_t times, bool DEBUG, bool TOO_BIG) {
+    const std::string dataset_name = datasetName(filename);
+    const std::string format = graphFormatName(graphFormatOf(filename));
+    const double file_mb = std::filesystem::file_size(filename) / (1024.0 * 1024.0);
+
+    int64_t total_us = 0;
+    size_t nnz = 0;
+    for(size_t i = 0; i < times; i++) {
+        Matrix csc, csr;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        try {
+            if(TOO_BIG) {
+                csc = loadFileToCSC<Matrix>(filename);
+            } else {
+                loadFileToCSCAndCSR(filename, csc, csr);
+            }
+        } catch(const std::exception& e) {
+            std::cout << "Could not load file: " << e.what() << std::endl;
+            return;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        const int64_t time = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), 1);
+        total_us += time;
+        nnz = csc.nnz;
+        std::cout << "DATASET: " << dataset_name << "\tFORMAT: " << format << "\tLOAD: " << time << "us\t"
+                  << file_mb * 1e6 / time << " MB/s\t" << nnz / (double) time << " Medges/s" << std::endl;
+    }
+
+    const double average_us = total_us / (double) times;
+    DEB("Loaded " << nnz << " edges from " << file_mb << "MB")
+    std::cout << "DATASET: " << dataset_name << "\tFORMAT: " << format << "\tAVERAGE LOAD: " << (int64_t) average_us << "us\t"
+              << file_mb * 1e6 / average_us << " MB/s\t" << nnz / average_us << " Medges/s" << std::endl;
+}
+
+/**
+ * @brief Measures the stream compaction of the vertices left, parallel_filter against std::erase_if, on a vertex list of
+ * the size of the graph with different fractions of the vertices still live, times times each
+ * @param filename the graph file, only its number of vertices is used
+ * @param times the number of compactions of every kind
+ * @param DEBUG if true, prints debug information
+ * @return (void)
+ */
+template <typename Matrix>
+void benchCompact(std::string filename, size_t times, bool DEBUG) {
+    using Vertex = typename Matrix::Vertex;
+    const std::string dataset_name = datasetName(filename);
+
+    size_t n = 0;
+    try {
+        n = loadFileToCSC<Matrix>(filename).n;
+    } catch(const std::exception& e) {
+        std::cout << "Could not load file: " << e.what() << std::endl;
+        return;
+    }
+    DEB("Compacting lists of " << n << " vertices")
+
+    // both halves of the double buffer keep their memory between the runs, like in the algorithm
+    Numa_vector<Vertex> vleft(n), vleft_buffer;
+    vleft.reserve(n);
+    vleft_buffer.reserve(n);
+    std::vector<uint8_t> live(n);
+    for(const size_t live_percent : {90, 50, 10}) {
+        // a multiplicative hash spreads the live vertices over the list, like the SCCs found by the coloring
+        parallel_for(0, n, [&](size_t v) {
+            live[v] = (v * 2654435761u) % 100 < live_percent;
+        });
+        auto keep = [&](size_t v) { return live[v] != 0; };
+
+        int64_t serial_us = 0, parallel_us = 0;
+        size_t kept = 0;
+        for(size_t i = 0; i < times; i++) {
+            parallel_for(0, n, [&](size_t v) { vleft[v] = v; });
+            auto start = std::chrono::high_resolution_clock::now();
+            std::erase_if(vleft, [&](size_t v) { return !keep(v); });
+            auto end = std::chrono::high_resolution_clock::now();
+            serial_us += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            kept = vleft.size();
+
+            vleft.resize(n);
+            parallel_for(0, n, [&](size_t v) { vleft[v] = v; });
+            start = std::chrono::high_resolution_clock::now();
+            parallel_filter(vleft, vleft_buffer, keep);
+            end = std::chrono::high_resolution_clock::now();
+            parallel_us += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            if(vleft.size() != kept) {
+                std::cout << "parallel_filter kept " << vleft.size() << " vertices instead of " << kept << std::endl;
+                return;
+            }
+            vleft.resize(n);
+        }
+
+        const double serial_average = std::max<double>(serial_us / (double) times, 1);
+        const double parallel_average = std::max<double>(parallel_us / (double) times, 1);
+        std::cout << "DATASET: " << dataset_name << "\tTHREADS: " << num_workers() << "\tLIVE: " << live_percent << "%\tERASE_IF: "
+                  << (int64_t) serial_average << "us\tFILTER: " << (int64_t) parallel_average << "us\t"
+                  << n / parallel_average << " Mvertices/s\tSPEEDUP: " << serial_average / parallel_average << std::endl;
     }
+}
 
+/**
+ * @brief Runs the algorithm times times and checks the number of SCCs of the known datasets
+ * @param new_id if the graph was renumbered, new_id[v] is the new id of vertex v of the file, otherwise nullptr
+ * @param first_trim the first trim done while loading, otherwise nullptr
+ * @param scc_options the optional phases of the algorithm
+ * @param after_first_run called once the first run is timed, otherwise nullptr
+ * @return the time of every run in us, mapping the SCC ids back to the file ids included
+ */
+template <typename Graph>
+std::vector<int64_t> runAndCheck(const Graph& csc, const Graph& csr, std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size_t NUM_THREADS,
+                                 const Numa_vector<typename Graph::Vertex>* new_id, const First_trim<typename Graph::Vertex>* first_trim,
+                                 const Scc_options& scc_options, const std::function<void()>& after_first_run = nullptr) {
     DEB("Running " << times << " times")
 
-    std::vector<size_t> SCC_id;
+    Numa_vector<typename Graph::Vertex> SCC_id;
     std::vector<int64_t> times_in_us;
 
-    std::string dataset_name = filename.substr(filename.find_last_of("/") + 1);
-    dataset_name = dataset_name.substr(0, dataset_name.find_last_of("."));
+    const std::string dataset_name = datasetName(filename);
 
     for(size_t i = 0; i < times; i++) {
         DEB("Starting run " << i)
         // csr may a null object, but that's fine, the next variable communicates that
         auto start = std::chrono::high_resolution_clock::now();
         if(!TOO_BIG) {
-            SCC_id = colorSCC_no_conversion(csc, csr, true, DEBUG, NUM_THREADS);
+            SCC_id = colorSCC_no_conversion(csc, csr, true, DEBUG, NUM_THREADS, first_trim, scc_options);
         } else {
-            SCC_id = colorSCC_no_conversion(csc, csr, false, DEBUG, NUM_THREADS);
+            SCC_id = colorSCC_no_conversion(csc, csr, false, DEBUG, NUM_THREADS, first_trim, scc_options);
         }
+        if(new_id != nullptr) permuteBack(SCC_id, *new_id);
         auto end = std::chrono::high_resolution_clock::now();
 
         auto time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
         times_in_us.push_back(time);
         std::cout << "DATASET: " << dataset_name << "\tTIME: " << time << "us" << std::endl;
         DEB("Finished run " << i)
+        if(i == 0 && after_first_run) after_first_run();
     }
     DEB("Finished all runs")
 
@@ -149,16 +428,295 @@ void testFile(std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size
     } else {
         std::cout << "ERROR: Unknown dataset " << dataset_name << "found " << real_scc_count << std::endl;
     }
+
+    return times_in_us;
+}
+
+double averageUs(const std::vector<int64_t>& times_in_us) {
+    int64_t total_us = 0;
+    for(const int64_t time : times_in_us) {
+        total_us += time;
+    }
+    return total_us / (double) times_in_us.size();
+}
+
+/**
+ * @brief Runs the algorithm on a loaded graph, gap encoding it first if the options ask for it
+ * @param csc the graph in CSC format
+ * @param csr the graph in CSR format, empty if TOO_BIG
+ * @param new_id if the graph was renumbered, new_id[v] is the new id of vertex v of the file, otherwise nullptr
+ * @param first_trim the first trim done while loading, otherwise nullptr
+ * @param after_first_run see runAndCheck
+ * @return the time of every run in us
+ */
+template <typename Matrix>
+std::vector<int64_t> runGraph(Matrix& csc, Matrix& csr, std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size_t NUM_THREADS, const Run_options& options,
+                              const Numa_vector<typename Matrix::Vertex>* new_id, const First_trim<typename Matrix::Vertex>* first_trim,
+                              const std::function<void()>& after_first_run = nullptr) {
+    if(!options.COMPRESS) {
+        return runAndCheck(csc, csr, filename, times, DEBUG, TOO_BIG, NUM_THREADS, new_id, first_trim, options.SCC, after_first_run);
+    }
+
+    using Compressed = Compressed_matrix<typename Matrix::Vertex>;
+
+    DEB("Compressing adjacency lists")
+    auto start_compress = std::chrono::high_resolution_clock::now();
+    Compressed compressed_csc = compressSparse(csc);
+    Compressed compressed_csr = TOO_BIG ? Compressed() : compressSparse(csr);
+    auto end_compress = std::chrono::high_resolution_clock::now();
+    DEB("Compressed from " << (csc.memory_size() + csr.memory_size()) / (1024 * 1024) << "MB to "
+        << (compressed_csc.memory_size() + compressed_csr.memory_size()) / (1024 * 1024) << "MB, toook "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(end_compress - start_compress).count() << "ms")
+
+    // only the compressed version is kept, unless the graph is reordered after this run
+    if(options.ORDER == ORDER_NONE || new_id != nullptr) {
+        csc = Matrix();
+        csr = Matrix();
+    }
+
+    return runAndCheck(compressed_csc, compressed_csr, filename, times, DEBUG, TOO_BIG, NUM_THREADS, new_id, first_trim, options.SCC, after_first_run);
+}
+
+/**
+ * @brief Runs the algorithm out of core: only the CSC is used, straight from the mapping of its binary cache, so the
+ * page cache holds as much of it as fits in memory. A missing cache is made by loadFileToBinaryCSC.
+ * @param filename the graph file
+ * @param times the number of runs
+ * @param DEBUG if true, prints debug information
+ * @param options the run options
+ * @return (void)
+ */
+template <typename Matrix>
+void testMatrixOutOfCore(std::string filename, size_t times, bool DEBUG, size_t NUM_THREADS, const Run_options& options) {
+    const std::string csc_binary = binaryName(filename, "csc", options);
+
+    Matrix csc;
+    if(!tryLoadBinary(csc_binary, filename, csc, options, DEBUG)) {
+        DEB("Loading file into " << csc_binary)
+        auto start_load = std::chrono::high_resolution_clock::now();
+        try {
+            const size_t removed = loadFileToBinaryCSC<Matrix>(filename, csc_binary, options.CANONICALIZE, options.REMOVE_SELF_LOOPS);
+            DEB("Removed " << removed << " edges while canonicalizing")
+            csc = loadBinaryToSparse<Matrix>(csc_binary, false);
+        } catch(const std::exception& e) {
+            std::cout << "Could not load file: " << e.what() << std::endl;
+            return;
+        }
+        auto end_load = std::chrono::high_resolution_clock::now();
+        DEB("Loaded file into " << csc_binary << ", toook " << std::chrono::duration_cast<std::chrono::milliseconds>(end_load - start_load).count() << "ms")
+    }
+
+    DEB("Running out of core on " << csc.memory_size() / (1024 * 1024) << "MB of mapped CSC")
+    runAndCheck(csc, Matrix(), filename, times, DEBUG, true, NUM_THREADS, nullptr, nullptr, options.SCC);
+}
+
+template <typename Matrix>
+void testMatrix(std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size_t NUM_THREADS, const Run_options& options) {
+    if(options.BENCH_LOAD) {
+        benchLoad<Matrix>(filename, times, DEBUG, TOO_BIG);
+        return;
+    }
+
+    if(options.BENCH_COMPACT) {
+        benchCompact<Matrix>(filename, times, DEBUG);
+        return;
+    }
+
+    if(options.OUT_OF_CORE) {
+        testMatrixOutOfCore<Matrix>(filename, times, DEBUG, NUM_THREADS, options);
+        return;
+    }
+
+    const std::string csc_binary = binaryName(filename, "csc", options);
+    const std::string csr_binary = binaryName(filename, "csr", options);
+
+    Matrix csc;
+    Matrix csr = Matrix();
+
+    // the time to the first result counts from here
+    auto start_map = std::chrono::high_resolution_clock::now();
+    const bool csc_mapped = tryLoadBinary(csc_binary, filename, csc, options, DEBUG);
+    const bool csr_mapped = !TOO_BIG && tryLoadBinary(csr_binary, filename, csr, options, DEBUG);
+    auto end_map = std::chrono::high_resolution_clock::now();
+    if(csc_mapped || csr_mapped) {
+        DEB("Mapped " << (csc_mapped ? csc_binary + " " : "") << (csr_mapped ? csr_binary + " " : "") << "toook "
+            << std::chrono::duration_cast<std::chrono::microseconds>(end_map - start_map).count() << "us")
+    }
+
+    // when neither is cached both are made from the same parse of the file, instead of transposing the CSC
+    const bool load_both = !csc_mapped && !csr_mapped && !TOO_BIG;
+
+    // pipelined, the first trim runs on the degrees while the loader is still filling the lists
+    const bool pipelined = options.PIPELINE && !csc_mapped;
+    First_trim<typename Matrix::Vertex> first_trim;
+    Degrees_ready<typename Matrix::Offset> on_degrees = nullptr;
+    if(pipelined) {
+        on_degrees = [&](const size_t n, const typename Matrix::Offset* in_ptr, const typename Matrix::Offset* out_ptr) {
+            first_trim = trimFromDegrees<typename Matrix::Vertex>(n, in_ptr, out_ptr);
+        };
+    }
+
+    // pipelined, the binary caches are written during the first run of the algorithm, the later runs wait for them
+    std::vector<std::thread> saves;
+    auto save = [&](const std::string& binary_filename, const Matrix& matrix) {
+        if(pipelined) {
+            saves.emplace_back([&, binary_filename]() { trySaveBinary(binary_filename, matrix, options, DEBUG); });
+        } else {
+            trySaveBinary(binary_filename, matrix, options, DEBUG);
+        }
+    };
+    auto wait_for_saves = [&]() {
+        for(std::thread& thread : saves) thread.join();
+        saves.clear();
+    };
+
+    if(!csc_mapped) {
+        DEB((load_both ? "Loading file into CSC and CSR" : "Loading file into CSC"))
+        auto start_load = std::chrono::high_resolution_clock::now();
+        try {
+            if(load_both) {
+                loadFileToCSCAndCSR(filename, csc, csr, on_degrees);
+            } else {
+                csc = loadFileToCSC<Matrix>(filename, on_degrees);
+            }
+        } catch(const std::exception& e) {
+            std::cout << "Could not load file: " << e.what() << std::endl;
+            return;
+        }
+        auto end_load = std::chrono::high_resolution_clock::now();
+        const auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(end_load - start_load).count();
+        const double load_mb = std::filesystem::file_size(filename) / (1024.0 * 1024.0);
+        DEB((load_both ? "Loaded file into CSC and CSR" : "Loaded file into CSC") << ", toook " << load_us / 1000
+            << "ms (" << load_mb * 1e6 / std::max<int64_t>(load_us, 1) << " MB/s)")
+
+        // a CSR made from a canonical CSC by the transpose is canonical too
+        tryCanonicalize(csc, options, DEBUG);
+        if(load_both) tryCanonicalize(csr, options, DEBUG);
+
+        save(csc_binary, csc);
+        if(load_both) save(csr_binary, csr);
+    }
+
+    if (TOO_BIG) {
+        DEB("File is too big, skipping CSR")
+    } else if(!csr_mapped && !load_both) {
+        DEB("Making CSR Version")
+        auto start_load_csr = std::chrono::high_resolution_clock::now();
+        csc_tocsr(csc, csr);
+        auto end_load_csr = std::chrono::high_resolution_clock::now();
+        DEB("Making CSR, toook " << std::chrono::duration_cast<std::chrono::milliseconds>(end_load_csr - start_load_csr).count() << "ms")
+
+        trySaveBinary(csr_binary, csr, options, DEBUG);
+    }
+
+    // compressing drops the graph the caches are written from
+    if(options.COMPRESS) wait_for_saves();
+
+    // the file order is the baseline, the renumbered graph runs after it
+    auto ready = std::chrono::high_resolution_clock::now();
+    const std::vector<int64_t> baseline_us = runGraph(csc, csr, filename, times, DEBUG, TOO_BIG, NUM_THREADS, options, nullptr,
+                                                      pipelined ? &first_trim : nullptr, wait_for_saves);
+    wait_for_saves();
+
+    // what pipelining cuts on cold caches, from the start of loading to the SCCs of the first run
+    std::cout << "DATASET: " << datasetName(filename) << "\tFIRST RESULT: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(ready - start_map).count() + baseline_us.front() << "us" << std::endl;
+
+    if(options.ORDER == ORDER_NONE) return;
+
+    DEB("Reordering vertices: " << vertexOrderName(options.ORDER))
+    auto start_reorder = std::chrono::high_resolution_clock::now();
+    const Numa_vector<typename Matrix::Vertex> new_id = vertexOrder(csc, TOO_BIG ? nullptr : &csr, options.ORDER);
+    permuteSparse(csc, new_id);
+    if(!TOO_BIG) permuteSparse(csr, new_id);
+    auto end_reorder = std::chrono::high_resolution_clock::now();
+    const double reorder_us = std::chrono::duration_cast<std::chrono::microseconds>(end_reorder - start_reorder).count();
+
+    // the first trim is in the ids of the file, the reordered run does its own
+    const double reordered_us = averageUs(runGraph(csc, csr, filename, times, DEBUG, TOO_BIG, NUM_THREADS, options, &new_id, nullptr));
+    const double average_baseline_us = averageUs(baseline_us);
+
+    // the end to end speedup pays the reordering for a single run
+    std::cout << "DATASET: " << datasetName(filename) << "\tORDER: " << vertexOrderName(options.ORDER) << "\tREORDER: " << (int64_t) reorder_us
+              << "us\tBASELINE: " << (int64_t) average_baseline_us << "us\tREORDERED: " << (int64_t) reordered_us << "us\tSPEEDUP: "
+              << average_baseline_us / reordered_us << "\tEND TO END SPEEDUP: " << average_baseline_us / (reorder_us + reordered_us) << std::endl;
+}
+
+void testFile(std::string filename, size_t times, bool DEBUG, bool TOO_BIG, size_t NUM_THREADS, const Run_options& options) {
+    // the matrices may be kept compressed, the loaders decompress them on the fly
+    if(!std::filesystem::exists(filename)) {
+        for(const std::string extension : {".gz", ".zst", ".xz"}) {
+            if(std::filesystem::exists(filename + extension)) {
+                filename += extension;
+                break;
+            }
+        }
+    }
+
+    if(!std::filesystem::exists(filename)) {
+        std::cout << "File not found: " << filename << std::endl;
+        return;
+    }
+
+    if(times == 0) {
+        std::cout << "Invalid number of times to run" << std::endl;
+        return;
+    }
+
+    Matrix_size size;
+    try {
+        DEB("Format: " << graphFormatName(graphFormatOf(filename)))
+        size = loadFileSize(filename);
+    } catch(const std::exception& e) {
+        std::cout << "Could not load file: " << e.what() << std::endl;
+        return;
+    }
+
+    // 32 bit indices halve the memory of the graph and of the per vertex arrays, the largest vertex value marks unassigned vertices
+    const size_t n = std::max(size.rows, size.cols);
+    if(n < UINT32_MAX && size.max_edges() <= UINT32_MAX) {
+        DEB("Using 32 bit vertices and 32 bit offsets")
+        testMatrix<Sparse_matrix_32>(filename, times, DEBUG, TOO_BIG, NUM_THREADS, options);
+    } else if(n < UINT32_MAX) {
+        DEB("Using 32 bit vertices and 64 bit offsets")
+        testMatrix<Sparse_matrix_32_64>(filename, times, DEBUG, TOO_BIG, NUM_THREADS, options);
+    } else {
+        DEB("Using 64 bit vertices and 64 bit offsets")
+        testMatrix<Sparse_matrix_64>(filename, times, DEBUG, TOO_BIG, NUM_THREADS, options);
+    }
 }
 
 int main(int argc, char** argv) {
+    Run_options options;
+
+    // the --flags can be anywhere, the rest of the arguments keep their positions
+    std::vector<std::string> args;
+    for(int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        if(arg.rfind("--", 0) != 0) {
+            args.push_back(arg);
+        } else if(!parseFlag(arg, options)) {
+            std::cout << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // the out of core run only ever sees the graph through the binary cache
+    if(options.OUT_OF_CORE && (!options.USE_CACHE || options.COMPRESS || options.ORDER != ORDER_NONE)) {
+        std::cout << "--out-of-core can not be used with --no-cache, --compress or --reorder" << std::endl;
+        return 1;
+    }
+
+    setNumaPlacement(options.NUMA_INTERLEAVE ? NUMA_INTERLEAVE : NUMA_FIRST_TOUCH);
+    setPageSize(options.PAGE_SIZE);
+
     size_t times = 1;
     bool DEBUG = false;
     bool TOO_BIG = false;
     size_t NUM_THREADS = 1;
 
-    if(argc == 1) {
-        std::cout << "Usage: " << argv[0] << " [relativeFilePath: path to \".mtx\" file or folder] [timesToRun: int] [DEBUG: 1 or 0] [TOO_BIG: 1 or 0] [NUM_THREADS: 1...24]\n" << std::endl;
+    if(args.size() == 1) {
+        std::cout << "Usage: " << argv[0] << " [relativeFilePath: path to a graph file or folder] [timesToRun: int] [DEBUG: 1 or 0] [TOO_BIG: 1 or 0] [NUM_THREADS: 1...24]\n" << std::endl;
 
         std::cout << "Description:\n" << std::endl;
         std::cout << "    relativeFilePath:     The path to the file to run, relative to the matrices folder" << std::endl;
@@ -168,7 +726,35 @@ int main(int argc, char** argv) {
         std::cout << "    NUM_THREADS:          The number of threads to use in the pthreads implementation" << std::endl;
         std::cout << std::endl;
 
-        std::cout << "Running with relativeFilePath not ending in \".mtx\" means this is the matrix folder the programm will try to run the algorithm on all files of the form:" << std::endl;
+        std::cout << "Options, anywhere in the command line:\n" << std::endl;
+        std::cout << "    --no-cache:           Do not use or write the binary cache (file.mtx.csc.bin, file.mtx.csr.bin) next to each \".mtx\" file" << std::endl;
+        std::cout << "    --verify-cache:       Check the checksum of the binary cache before using it" << std::endl;
+        std::cout << "    --compress:           Run on gap encoded adjacency lists, several times smaller on web graphs but decoded on every access" << std::endl;
+        std::cout << "    --no-canonicalize:    Keep the adjacency lists as in the file, unsorted and with duplicate edges" << std::endl;
+        std::cout << "    --keep-self-loops:    Do not remove the self loops while canonicalizing" << std::endl;
+        std::cout << "    --bench-load:         Only measure the loading throughput of each file, timesToRun times, without the binary cache" << std::endl;
+        std::cout << "    --bench-compact:      Only measure the compaction of the vertices left, parallel_filter against std::erase_if, on a list of the size of each file" << std::endl;
+        std::cout << "    --out-of-core:        For graphs larger than memory: make the binary cache of the CSC without loading the graph and run on its mapping, like TOO_BIG" << std::endl;
+        std::cout << "    --numa-interleave:    Interleave the graph and the per vertex arrays over all NUMA nodes instead of placing them by parallel first touch" << std::endl;
+        std::cout << "    --huge-pages:         Back the graph and the per vertex arrays with transparent huge pages" << std::endl;
+        std::cout << "    --huge-pages=2M, 1G:  Use reserved hugetlbfs pages of that size (see /proc/sys/vm/nr_hugepages) for the blocks at least that large, smaller pages below, falling back to transparent huge pages" << std::endl;
+        std::cout << "    --reorder=ORDER:      Also run after renumbering the vertices by degree (hubs first), rcm or gorder, and report the speedup and the cost of reordering" << std::endl;
+        std::cout << "    --pipeline:           When parsing the file, count the degrees as it is read, trim while the lists are filled and write the cache while running" << std::endl;
+        std::cout << "    --fw-bw:              After the first trim, take the SCC of a high degree pivot with a forward and a backward search (not with TOO_BIG)" << std::endl;
+        std::cout << "    --trim2:              After every trim, also trim the SCCs of two vertices that are each other's only live neighbor" << std::endl;
+        std::cout << "    --trim3:              After every trim, also trim the SCCs of three vertices without other live neighbors on one side" << std::endl;
+        std::cout << "    --worklist-trim:      Trim to the fixpoint with a worklist on live degree counts, instead of one scan of the vertices left per iteration (not with TOO_BIG)" << std::endl;
+        std::cout << "    --frontier-coloring:  Color with sweeps over only the vertices whose incoming neighbors changed color, as a list or a scan of the flags (not with TOO_BIG)" << std::endl;
+        std::cout << "    --push-pull:          Frontier coloring that pushes the colors of small frontiers with an atomic min and pulls for large ones, by edge counts (not with TOO_BIG)" << std::endl;
+        std::cout << "    --shortcut:           After every coloring sweep, every vertex takes the color of the vertex its color names, compare Total tries with DEBUG against a run without it" << std::endl;
+        std::cout << "    --parallel-bfs:       The colors with many vertices get a parallel, direction optimizing BFS, the small ones keep the serial BFS" << std::endl;
+        std::cout << "    --compact:            Once fewer than 1/8 of the vertices are left, run the rest on the subgraph they induce, renumbered and with only the live edges" << std::endl;
+        std::cout << std::endl;
+
+        std::cout << "Graph files can be MatrixMarket (.mtx), SNAP edge lists (.txt, .tsv, .el, .edges), METIS (.graph, .metis) or Galois binary (.gr), text files may be compressed (.gz, .xz, .zst)" << std::endl;
+        std::cout << "Files with other extensions are recognized by their contents, except METIS\n" << std::endl;
+
+        std::cout << "Running with relativeFilePath being a folder means this is the matrix folder the programm will try to run the algorithm on all files of the form:" << std::endl;
         std::cout << "      relativeFilePath/celegansneural/celegansneural.mtx,\n      relativeFilePath/foldoc/foldoc.mtx\n      ... etc ...\n      for all known datasets from the SPARSE MATIX COLLECTION." << std::endl;
         std::cout << std::endl;
 
@@ -181,32 +767,35 @@ int main(int argc, char** argv) {
 
         std::cout << "Running test with default dataset: " << std::endl;
         std::cout << std::endl;
-        testFile(DEFAULT_PREFIX + std::string("language/language.mtx"), times, DEBUG, TOO_BIG, NUM_THREADS);
+        testFile(DEFAULT_PREFIX + std::string("language/language.mtx"), times, DEBUG, TOO_BIG, NUM_THREADS, options);
         return 0;
     }
 
-    if(argc > 2) {
-        times = std::stoi(argv[2]);
+    if(args.size() > 2) {
+        times = std::stoi(args[2]);
     }
 
-    if(argc > 3) {
-        DEBUG = std::stoi(argv[3]) == 1;
+    if(args.size() > 3) {
+        DEBUG = std::stoi(args[3]) == 1;
     }
 
-    if(argc > 4) {
-        TOO_BIG = std::stoi(argv[4]) == 1;
+    if(args.size() > 4) {
+        TOO_BIG = std::stoi(args[4]) == 1;
     }
 
-    if(argc > 5) {
-        NUM_THREADS = std::stoi(argv[5]);
+    if(args.size() > 5) {
+        NUM_THREADS = std::stoi(args[5]);
     }
 
+    // the loaders use the same number of threads as the algorithm
+    PARALLEL_NUM_THREADS = NUM_THREADS;
+
     std::vector<std::string> filesToRun;
  
-    if(argc > 1) {
-        std::string inputFilename = argv[1];
-        // check if it ends in .mtx
-        if(inputFilename.substr(inputFilename.size() - 4) == ".mtx") {
+    if(args.size() > 1) {
+        std::string inputFilename = args[1];
+        // any file is loaded, its format is found by graphFormatOf, a folder runs the known datasets
+        if(!std::filesystem::is_directory(inputFilename)) {
             filesToRun = {inputFilename};
         } else {
             if(inputFilename.substr(inputFilename.size() - 1) == "/") {
@@ -235,11 +824,33 @@ int main(int argc, char** argv) {
     std::cout << "Times: " << times << std::endl;
     std::cout << "Debug: " << DEBUG << std::endl;
     std::cout << "Too big: " << TOO_BIG << std::endl;
+    std::cout << "Out of core: " << options.OUT_OF_CORE << std::endl;
+    std::cout << "Reorder: " << vertexOrderName(options.ORDER) << std::endl;
+    std::cout << "Pipeline: " << options.PIPELINE << std::endl;
+    std::cout << "FW-BW: " << options.SCC.FW_BW << std::endl;
+    std::cout << "Trim2: " << options.SCC.TRIM2 << std::endl;
+    std::cout << "Trim3: " << options.SCC.TRIM3 << std::endl;
+    std::cout << "Worklist trim: " << options.SCC.WORKLIST_TRIM << std::endl;
+    std::cout << "Frontier coloring: " << options.SCC.FRONTIER_COLORING << std::endl;
+    std::cout << "Push-pull coloring: " << options.SCC.PUSH_PULL << std::endl;
+    std::cout << "Shortcut coloring: " << options.SCC.SHORTCUT << std::endl;
+    std::cout << "Parallel BFS: " << options.SCC.PARALLEL_BFS << std::endl;
+    std::cout << "Compact subgraph: " << options.SCC.COMPACT << std::endl;
+    std::cout << "NUMA: " << (options.NUMA_INTERLEAVE ? "interleave" : "first touch") << std::endl;
+    std::cout << "Pages: " << (options.PAGE_SIZE == PAGES_NORMAL ? "normal" : options.PAGE_SIZE == PAGES_TRANSPARENT_HUGE ? "transparent huge" :
+                               options.PAGE_SIZE == PAGES_HUGETLB_2M ? "2M hugetlb" : "1G hugetlb") << std::endl;
+    std::cout << "Cache: " << options.USE_CACHE << std::endl;
+    std::cout << "Canonicalize: " << options.CANONICALIZE << (options.CANONICALIZE && options.REMOVE_SELF_LOOPS ? " (no self loops)" : "") << std::endl;
 
     std::cout << std::endl;
 
     for(auto& filename : filesToRun) {
-        testFile(filename, times, DEBUG, TOO_BIG, NUM_THREADS);
+        testFile(filename, times, DEBUG, TOO_BIG, NUM_THREADS, options);
+    }
+
+    // the A/B comparison is only fair if the huge pages were there
+    if(hugePageFallbacks() > 0) {
+        std::cout << "WARNING: " << hugePageFallbacks() << " allocations got no hugetlbfs pages of their size and fell back to smaller pages" << std::endl;
     }
 
     std::cout << std::endl;
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include <pthread.h>
+
+// Small set of parallel building blocks used by the loaders and the graph kernels.
+// Every backend directory has its own version of this file with the same interface,
+// so the code that uses it (sparse_util.cpp) can stay the same across backends.
+
+/**
+ * @brief The number of threads the parallel loops will use. Set from main with the NUM_THREADS argument.
+ */
+inline size_t PARALLEL_NUM_THREADS = 1;
+
+/**
+ * @brief The number of workers the parallel loops of this backend will use
+ * @return the number of threads that parallel_for dispatches
+ */
+inline size_t num_workers() {
+    return PARALLEL_NUM_THREADS;
+}
+
+/**
+ * @brief Needed for parallel_for. Contains the loop body and the range of one thread.
+ */
+template <typename F>
+struct parallel_for_runner_struct
+{
+    F* f;
+    size_t start;
+    size_t end;
+};
+
+/**
+ * @brief Runs the loop body for a range of indices. It represents one thread in parallel_for.
+ * @param info A struct containing the loop body and the range
+ * @return (void*)
+ */
+template <typename F>
+void* parallel_for_runner(void* info) {
+    auto* range = (parallel_for_runner_struct<F>*) info;
+
+    for(size_t i = range->start; i < range->end; i++) {
+        (*range->f)(i);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs f(i) for every i in [begin, end), statically partitioned over PARALLEL_NUM_THREADS threads
+ * @param begin first index
+ * @param end one past the last index
+ * @param f the loop body
+ * @return (void)
+ */
+template <typename F>
+void parallel_for(const size_t begin, const size_t end, F&& f) {
+    using Body = std::remove_reference_t<F>;
+
+    const size_t count = end - begin;
+    const size_t threads_to_use = std::min(num_workers(), count);
+
+    if(threads_to_use <= 1) {
+        for(size_t i = begin; i < end; i++) {
+            f(i);
+        }
+        return;
+    }
+
+    std::vector<pthread_t> threads(threads_to_use);
+    std::vector<parallel_for_runner_struct<Body>> ranges(threads_to_use);
+
+    for(size_t t = 0; t < threads_to_use; t++) {
+        // equally split partitions
+        ranges[t] = {&f, begin + t * count / threads_to_use, begin + (t + 1) * count / threads_to_use};
+        pthread_create(&threads[t], NULL, parallel_for_runner<Body>, &ranges[t]);
+    }
+
+    for(size_t t = 0; t < threads_to_use; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+/**
+ * @brief In place exclusive prefix sum, data[i] becomes the sum of data[0..i)
+ * @param data the array to scan
+ * @param count the number of elements of data
+ * @return the sum of all elements
+ */
+template <typename T>
+T parallel_exclusive_scan(T* data, const size_t count) {
+    const size_t blocks = std::min(num_workers(), count / 4096 + 1);
+
+    // first pass: the sum of every block
+    std::vector<T> block_sum(blocks + 1, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        const size_t start = b * count / blocks;
+        const size_t end = (b + 1) * count / blocks;
+
+        T sum = 0;
+        for(size_t i = start; i < end; i++) {
+            sum += data[i];
+        }
+        block_sum[b + 1] = sum;
+    });
+
+    for(size_t b = 0; b < blocks; b++) {
+        block_sum[b + 1] += block_sum[b];
+    }
+
+    // second pass: every block scans itself starting from the sum of the blocks before it
+    parallel_for(0, blocks, [&](size_t b) {
+        const size_t start = b * count / blocks;
+        const size_t end = (b + 1) * count / blocks;
+
+        T cumsum = block_sum[b];
+        for(size_t i = start; i < end; i++) {
+            T temp = data[i];
+            data[i] = cumsum;
+            cumsum += temp;
+        }
+    });
+
+    return block_sum[blocks];
+}
+
+/**
+ * @brief Stream compaction, copies the elements of input for which keep(element) is true to output, in their order.
+ * Every block counts the elements it keeps, an exclusive scan of the counts gives the place every block starts writing
+ * at, and the blocks copy their elements there, so output is written once and in parallel
+ * @param input the elements to filter
+ * @param output gets exactly the kept elements, its memory is reused if it is large enough
+ * @param keep the predicate, called up to twice for every element, it must give the same answer both times
+ * @return the number of kept elements
+ */
+template <typename Input, typename Output, typename Keep>
+size_t parallel_copy_if(const Input& input, Output& output, Keep&& keep) {
+    const size_t count = input.size();
+    const size_t blocks = std::min(num_workers(), count / 4096 + 1);
+
+    // a single block needs no counts, it is copied in one pass and output is cut to the kept elements
+    if(blocks == 1) {
+        output.resize(count);
+        size_t out = 0;
+        for(size_t i = 0; i < count; i++) {
+            if(keep(input[i])) {
+                output[out++] = input[i];
+            }
+        }
+        output.resize(out);
+        return out;
+    }
+
+    // first pass: the number of kept elements of every block, then where each block writes
+    std::vector<size_t> offset(blocks + 1, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        const size_t start = b * count / blocks;
+        const size_t end = (b + 1) * count / blocks;
+
+        size_t kept = 0;
+        for(size_t i = start; i < end; i++) {
+            kept += keep(input[i]) ? 1 : 0;
+        }
+        offset[b] = kept;
+    });
+    const size_t total = parallel_exclusive_scan(offset.data(), blocks + 1);
+
+    // second pass: every block scatters its kept elements starting from its offset
+    output.resize(total);
+    parallel_for(0, blocks, [&](size_t b) {
+        const size_t start = b * count / blocks;
+        const size_t end = (b + 1) * count / blocks;
+
+        size_t out = offset[b];
+        for(size_t i = start; i < end; i++) {
+            if(keep(input[i])) {
+                output[out++] = input[i];
+            }
+        }
+    });
+
+    return total;
+}
+
+/**
+ * @brief Parallel replacement of std::erase_if, keeps the elements of values for which keep(element) is true, in
+ * their order. The kept elements are compacted into buffer and the two are swapped, so values and buffer form a double
+ * buffer and calling this again with the same buffer allocates nothing
+ * @param values the elements to filter
+ * @param buffer scratch of the same type as values, its contents are lost
+ * @param keep the predicate, called up to twice for every element, it must give the same answer both times
+ * @return the number of removed elements
+ */
+template <typename Vector, typename Keep>
+size_t parallel_filter(Vector& values, Vector& buffer, Keep&& keep) {
+    const size_t count = values.size();
+    const size_t kept = parallel_copy_if(values, buffer, keep);
+    values.swap(buffer);
+
+    return count - kept;
+}
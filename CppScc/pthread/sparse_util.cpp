@@ -1,35 +1,44 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <stdexcept>
+#include <filesystem>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <atomic>
+#include <queue>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// the decompressors are optional, the makefile defines these when their headers are installed
+#ifdef SCC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SCC_HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef SCC_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #define UNASSIGNED -1
 #define NO_COLOR -1
 
 #include "sparse_util.hpp"
-
-Coo_matrix loadFileToCoo(const std::string filename) {
-    std::ifstream fin(filename);
-
-    size_t n, nnz;
-    while(fin.peek() == '%') fin.ignore(2048, '\n');
-
-    fin >> n >> n >> nnz;
-
-    std::vector<size_t> Ai(nnz);
-    std::vector<size_t> Aj(nnz);
-
-    size_t throwaway;
-    // lines may be of the form: i j or i j throwaway
-    for(size_t i = 0; i < nnz; ++i) {
-        fin >> Ai[i] >> Aj[i];
-        Ai[i]--;
-        Aj[i]--;
-        if(fin.peek() != '\n') fin >> throwaway;
-    }
-
-    // automatically moves the vectors, no copying is done here
-    return Coo_matrix{n, nnz, std::move(Ai), std::move(Aj)};
-}
+#include "parallel_util.hpp"
 
 /*
 Sparse_matrix loadFileToCSC(const std::string filename) {
@@ -63,162 +72,2497 @@ Sparse_matrix loadFileToCSC(const std::string filename) {
 }
 */
 
-Sparse_matrix loadFileToCSC(const std::string filename) {
-    FILE *fin = fopen(filename.c_str(), "r");
+Mapped_file::Mapped_file(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Could not open " + filename);
+    }
 
-    size_t n = -1, nnz;
-    while(fgetc(fin) == '%') {
-        while(fgetc(fin) != '\n') {
-            // do nothing
-        };
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + filename);
     }
+    size = st.st_size;
 
-    fscanf(fin, "%zu %zu %zu", &n, &n, &nnz);
+    if(size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not mmap " + filename);
+        }
+        data = (const char*) mapped;
+    }
+    close(fd);
+}
 
-    std::vector<size_t> ptr(n+1, 0);
-    std::vector<size_t> val(nnz);
+Mapped_file::Mapped_file(const std::string& filename, const size_t size) : size(size), writable(true) {
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        throw std::runtime_error("Could not create " + filename);
+    }
 
-    size_t i, j, throwaway;
-    // lines may be of the form: i j or i j throwaway where throwaway can be any number of characters until a newline
-    for(size_t ind = 0; ind < nnz; ++ind) {
-        fscanf(fin, "%zu %zu", &i, &j);
-        --i; --j;
+    // the file is sparse until written, so making it does not touch the disk
+    if(ftruncate(fd, size) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not resize " + filename);
+    }
 
-        val[ind] = i;
-        ptr[j+1]++;
-        
-        if(fgetc(fin) != '\n') {
-            while(fgetc(fin) != '\n') {
-                // do nothing
-            };
+    if(size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not mmap " + filename);
         }
+        data = (const char*) mapped;
     }
+    close(fd);
+}
 
-    for(size_t i = 0; i < n; ++i) {
-        ptr[i+1] += ptr[i];
+Mapped_file::~Mapped_file() {
+    if(data != nullptr) munmap((void*) data, size);
+}
+
+// blocks smaller than this come from calloc, placing them is not worth a system call
+#define NUMA_MIN_BYTES (1 << 20)
+// from <numaif.h>, called through syscall so there is no libnuma to link
+#define NUMA_MPOL_INTERLEAVE 3
+// the huge page size of x86-64 and arm64, the large blocks are aligned to it so the kernel can use huge pages
+#define HUGE_PAGE_BYTES (2UL << 20)
+#define GIANT_PAGE_BYTES (1UL << 30)
+
+static Numa_placement numa_placement = NUMA_FIRST_TOUCH;
+static Page_size page_size = PAGES_NORMAL;
+static std::atomic<size_t> huge_page_fallbacks(0);
+
+void setNumaPlacement(const Numa_placement placement) {
+    numa_placement = placement;
+}
+
+void setPageSize(const Page_size size) {
+    page_size = size;
+}
+
+size_t hugePageFallbacks() {
+    return huge_page_fallbacks;
+}
+
+// the nodes that have memory, from a list like "0-1,4" in sysfs
+static std::vector<unsigned long> numa_memory_nodes() {
+    std::vector<unsigned long> mask(1, 0);
+    std::ifstream fin("/sys/devices/system/node/has_memory");
+    size_t first, last;
+    while(fin >> first) {
+        last = first;
+        if(fin.peek() == '-') {
+            fin.get();
+            fin >> last;
+        }
+        for(size_t node = first; node <= last; node++) {
+            const size_t bits = 8 * sizeof(unsigned long);
+            if(node / bits >= mask.size()) mask.resize(node / bits + 1, 0);
+            mask[node / bits] |= 1UL << (node % bits);
+        }
+        if(fin.peek() == ',') fin.get();
     }
+    return mask;
+}
 
-    // automatically moves the vectors, no copying is done here
-    return Sparse_matrix{n, nnz, std::move(ptr), std::move(val), Sparse_matrix::CSC};
+// the pages of a large block: the largest size asked for that the block fills at least once, so less than half of its
+// mapping is padding and small arrays do not take whole pages of the reserved pool
+static size_t block_page(const size_t bytes) {
+    if(page_size == PAGES_NORMAL || bytes < HUGE_PAGE_BYTES) return 4096;
+    if(page_size == PAGES_HUGETLB_1G && bytes >= GIANT_PAGE_BYTES) return GIANT_PAGE_BYTES;
+    return HUGE_PAGE_BYTES;
 }
 
+// the length of the mapping of a large block, whole pages of the size block_page gives it
+static size_t mapped_length(const size_t bytes) {
+    const size_t page = block_page(bytes);
+    return (bytes + page - 1) / page * page;
+}
 
-void csr_tocsc(const Sparse_matrix& csr, Sparse_matrix& csc) {
-    csc.n = csr.n;
-    csc.nnz = csr.nnz;
-    csc.ptr.resize(csr.n + 1);
-    csc.val.resize(csr.nnz);
-    csc.type = Sparse_matrix::CSC;
+// maps length bytes starting at a multiple of alignment, by mapping more and cutting off both ends
+static void* map_aligned(const size_t length, const size_t alignment) {
+    char* data = (char*) mmap(nullptr, length + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED) return nullptr;
 
-    csr_tocsc(csr.n, csr.ptr, csr.val, csc.ptr, csc.val);
+    char* aligned = (char*)(((uintptr_t) data + alignment - 1) / alignment * alignment);
+    if(aligned > data) munmap(data, aligned - data);
+    munmap(aligned + length, data + alignment - aligned);
+    return aligned;
 }
 
-void csc_tocsr(const Sparse_matrix& csc, Sparse_matrix& csr) {
-    csr_tocsc(csc, csr);
+void* numaAllocate(const size_t bytes) {
+    if(bytes < NUMA_MIN_BYTES) {
+        void* data = std::calloc(bytes, 1);
+        if(data == nullptr) throw std::bad_alloc();
+        return data;
+    }
+
+    // fresh anonymous pages read as zero and are only placed when first written
+    const size_t page = block_page(bytes);
+    const size_t length = mapped_length(bytes);
+    void* data = nullptr;
+    if(page > 4096 && (page_size == PAGES_HUGETLB_2M || page_size == PAGES_HUGETLB_1G)) {
+        // a block of 1G pages tries the 2M pool next, its length is a multiple of both
+        size_t got_page = 0;
+        for(const size_t hugetlb_page : {GIANT_PAGE_BYTES, HUGE_PAGE_BYTES}) {
+            if(hugetlb_page > page) continue;
+            const int size_flag = (hugetlb_page == GIANT_PAGE_BYTES ? 30 : 21) << MAP_HUGE_SHIFT;
+            data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+            if(data != MAP_FAILED) {
+                got_page = hugetlb_page;
+                break;
+            }
+            data = nullptr;
+        }
+        if(got_page != page) huge_page_fallbacks++;
+    }
+    if(data == nullptr && page == 4096) {
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data == MAP_FAILED) throw std::bad_alloc();
+    } else if(data == nullptr) {
+        data = map_aligned(length, HUGE_PAGE_BYTES);
+        if(data == nullptr) throw std::bad_alloc();
+        // only a hint, without transparent huge pages in the kernel the block keeps normal pages
+        madvise(data, length, MADV_HUGEPAGE);
+    }
+
+    if(numa_placement == NUMA_INTERLEAVE) {
+        static const std::vector<unsigned long> nodes = numa_memory_nodes();
+        // only a placement policy, a failure leaves first touch
+        syscall(SYS_mbind, data, length, NUMA_MPOL_INTERLEAVE, nodes.data(), 8 * sizeof(unsigned long) * nodes.size() + 1, 0);
+    }
+    return data;
 }
 
-void csr_tocsc(const size_t n, const std::vector<size_t>& Ap, const std::vector<size_t>& Aj, 
-	                std::vector<size_t>& Bp, std::vector<size_t>& Bi) {  
-    const size_t nnz = Ap[n];
+void numaDeallocate(void* data, const size_t bytes) {
+    if(bytes < NUMA_MIN_BYTES) {
+        std::free(data);
+    } else {
+        munmap(data, mapped_length(bytes));
+    }
+}
+
+void adviseMapped(const void* data, const size_t bytes, const Access_pattern pattern) {
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t) data / page * page;
+    const uintptr_t end = (uintptr_t) data + bytes;
+
+    const int advice = pattern == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL :
+                       pattern == ACCESS_RANDOM ? MADV_RANDOM :
+                       pattern == ACCESS_WILL_NEED ? MADV_WILLNEED : MADV_NORMAL;
+    // only a hint, a failure changes nothing
+    madvise((void*) begin, end - begin, advice);
+}
+
+// hand written integer parsing, much faster than fscanf since there is no locale or format string to handle
+static inline bool is_digit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* skip_blanks(const char* p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static inline const char* skip_line(const char* p, const char* end) {
+    while(p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
+
+static inline const char* parse_index(const char* p, const char* end, size_t& value) {
+    value = 0;
+    while(p < end && is_digit(*p)) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return p;
+}
 
-    //compute number of non-zero entries per column of A 
-    std::fill(Bp.begin(), Bp.end(), 0);
+/**
+ * @brief Parses one "i j [value]" line of the coordinate section of a MatrixMarket file. Skips lines that are not entries.
+ * @param p the start of the line
+ * @param end the end of the chunk
+ * @param i the row, 1 based as in the file
+ * @param j the column, 1 based as in the file
+ * @param is_entry set to false if the line was empty or a comment
+ * @return the start of the next line
+ */
+static inline const char* parse_entry(const char* p, const char* end, size_t& i, size_t& j, bool& is_entry) {
+    p = skip_blanks(p, end);
+    is_entry = p < end && is_digit(*p);
 
-    for (size_t n = 0; n < nnz; n++){            
-        Bp[Aj[n]]++;
+    if(is_entry) {
+        p = parse_index(p, end, i);
+        p = skip_blanks(p, end);
+        p = parse_index(p, end, j);
     }
 
-    //cumsum the nnz per column to get Bp[]
-    for(size_t col = 0, cumsum = 0; col < n; col++){     
-        size_t temp  = Bp[col];
-        Bp[col] = cumsum;
-        cumsum += temp;
+    // the rest of the line can be a value of any type, we only need the pattern
+    return skip_line(p, end);
+}
+
+/**
+ * @brief Reads the next word of a line, lower cased, MatrixMarket qualifiers are case insensitive
+ * @param p the start of the word, or of the blanks before it
+ * @param end the end of the file
+ * @param word the word that was read
+ * @return the position after the word
+ */
+static const char* parse_word(const char* p, const char* end, std::string& word) {
+    p = skip_blanks(p, end);
+    word.clear();
+    while(p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+        word += std::tolower(*p);
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Parses the %%MatrixMarket banner, skips the comments and parses the size line. A file without a banner
+ * is read as a general coordinate matrix.
+ * @param p the start of the file
+ * @param end the end of the file
+ * @param size the size and qualifiers that were read
+ * @return the start of the first entry
+ */
+static const char* parse_header(const char* p, const char* end, Matrix_size& size) {
+    const char banner[] = "%%MatrixMarket";
+    if((size_t)(end - p) >= sizeof(banner) - 1 && std::equal(banner, banner + sizeof(banner) - 1, p)) {
+        std::string object, format, field, symmetry;
+        p = parse_word(p + sizeof(banner) - 1, end, object);
+        p = parse_word(p, end, format);
+        p = parse_word(p, end, field);
+        p = parse_word(p, end, symmetry);
+
+        if(object != "matrix" || format != "coordinate") {
+            throw std::runtime_error("only coordinate MatrixMarket matrices are supported, not " + object + " " + format);
+        }
+
+        if(field == "pattern") {
+            size.pattern = true;
+        } else if(field != "real" && field != "integer" && field != "complex") {
+            throw std::runtime_error("unknown MatrixMarket field: " + field);
+        }
+
+        if(symmetry == "symmetric" || symmetry == "skew-symmetric" || symmetry == "hermitian") {
+            size.symmetric = true;
+        } else if(symmetry != "general") {
+            throw std::runtime_error("unknown MatrixMarket symmetry: " + symmetry);
+        }
+
+        p = skip_line(p, end);
     }
-    Bp[n] = nnz; 
 
-    for(size_t row = 0; row < n; row++){
-        for(size_t jj = Ap[row]; jj < Ap[row+1]; jj++){
-            size_t col  = Aj[jj];
-            size_t dest = Bp[col];
+    while(p < end && *p == '%') p = skip_line(p, end);
+
+    p = skip_blanks(p, end);
+    p = parse_index(p, end, size.rows);
+    p = skip_blanks(p, end);
+    p = parse_index(p, end, size.cols);
+    p = skip_blanks(p, end);
+    p = parse_index(p, end, size.nnz);
+
+    return skip_line(p, end);
+}
+
+// compressed inputs are decoded in pieces of this size, and cut into text buffers of about this size for the parse threads
+#define STREAM_BUFFER_SIZE (4 << 20)
 
-            Bi[dest] = row;
-            Bp[col]++;
+enum Compression {UNCOMPRESSED, GZIP, XZ, ZSTD};
+
+/**
+ * @brief Finds the compression of a file from its magic bytes, so a wrong extension does not matter
+ * @param file the mapped file
+ * @return the compression of the file
+ */
+static Compression compression_of(const Mapped_file& file) {
+    const unsigned char* magic = (const unsigned char*) file.data;
+
+    if(file.size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return GZIP;
+    if(file.size >= 6 && std::memcmp(magic, "\xfd" "7zXZ\0", 6) == 0) return XZ;
+    if(file.size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) return ZSTD;
+    return UNCOMPRESSED;
+}
+
+std::string stripCompressionExtension(const std::string filename) {
+    for(const std::string extension : {".gz", ".xz", ".zst"}) {
+        if(filename.size() > extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+            return filename.substr(0, filename.size() - extension.size());
         }
     }
+    return filename;
+}
+
+// gets the decompressed bytes in order, returns false to stop decoding
+using Decode_sink = std::function<bool(const char*, size_t)>;
+
+#ifdef SCC_HAVE_ZLIB
+// handles files of several concatenated gzip members, like the ones of pigz or cat a.gz b.gz
+static void decode_gzip(const Mapped_file& file, const Decode_sink& sink) {
+    z_stream stream = {};
+    // 32 lets zlib detect the gzip header
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+        throw std::runtime_error("could not start the gzip decoder");
+    }
+    std::unique_ptr<z_stream, int(*)(z_stream*)> guard(&stream, inflateEnd);
 
-    for(size_t col = 0, last = 0; col <= n; col++){
-        size_t temp  = Bp[col];
-        Bp[col] = last;
-        last    = temp;
+    std::vector<char> out(STREAM_BUFFER_SIZE);
+    const char* next_in = file.data;
+    const char* end_in = file.data + file.size;
+
+    while(true) {
+        // avail_in is 32 bit, the input is given in pieces
+        if(stream.avail_in == 0 && next_in < end_in) {
+            stream.next_in = (Bytef*) next_in;
+            stream.avail_in = std::min<size_t>(end_in - next_in, 1 << 30);
+            next_in += stream.avail_in;
+        }
+
+        stream.next_out = (Bytef*) out.data();
+        stream.avail_out = out.size();
+        const int ret = inflate(&stream, Z_NO_FLUSH);
+
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            throw std::runtime_error(std::string("gzip: ") + (stream.msg ? stream.msg : "corrupt data"));
+        }
+
+        const size_t produced = out.size() - stream.avail_out;
+        if(produced > 0 && !sink(out.data(), produced)) return;
+
+        if(ret == Z_STREAM_END) {
+            if(stream.avail_in == 0 && next_in == end_in) return;
+            inflateReset(&stream);
+        } else if(ret == Z_BUF_ERROR && stream.avail_in == 0 && next_in == end_in) {
+            throw std::runtime_error("gzip: the file is truncated");
+        }
     }
 }
+#endif
 
-void coo_tocsr(const Coo_matrix& coo, Sparse_matrix& csr) {
-    csr.n = coo.n;
-    csr.nnz = coo.nnz;
-    csr.ptr.resize(coo.n + 1);
-    csr.val.resize(coo.nnz);
-    csr.type = Sparse_matrix::CSR;
+#ifdef SCC_HAVE_LZMA
+static void decode_xz(const Mapped_file& file, const Decode_sink& sink) {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if(lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+        throw std::runtime_error("could not start the xz decoder");
+    }
+    std::unique_ptr<lzma_stream, void(*)(lzma_stream*)> guard(&stream, lzma_end);
+
+    std::vector<char> out(STREAM_BUFFER_SIZE);
+    stream.next_in = (const uint8_t*) file.data;
+    stream.avail_in = file.size;
+
+    while(true) {
+        stream.next_out = (uint8_t*) out.data();
+        stream.avail_out = out.size();
+        const lzma_ret ret = lzma_code(&stream, LZMA_FINISH);
+
+        if(ret != LZMA_OK && ret != LZMA_STREAM_END) {
+            throw std::runtime_error("xz: corrupt or truncated data, error " + std::to_string(ret));
+        }
 
-    std::fill(csr.ptr.begin(), csr.ptr.end(), 0);
+        const size_t produced = out.size() - stream.avail_out;
+        if(produced > 0 && !sink(out.data(), produced)) return;
 
-    for(size_t n = 0; n < coo.nnz; n++) {
-        csr.ptr[coo.Ai[n]]++;
+        if(ret == LZMA_STREAM_END) return;
     }
+}
+#endif
 
-    for(size_t i = 0, cumsum = 0; i < coo.n; i++) {
-        size_t temp = csr.ptr[i];
-        csr.ptr[i] = cumsum;
-        cumsum += temp;
+#ifdef SCC_HAVE_ZSTD
+// ZSTD_decompressStream moves on to the next frame by itself
+static void decode_zstd(const Mapped_file& file, const Decode_sink& sink) {
+    std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if(!context) {
+        throw std::runtime_error("could not start the zstd decoder");
     }
-    csr.ptr[coo.n] = coo.nnz;
 
-    for(size_t n = 0; n < coo.nnz; n++) {
-        size_t row = coo.Ai[n];
-        size_t dest = csr.ptr[row];
+    std::vector<char> out(STREAM_BUFFER_SIZE);
+    ZSTD_inBuffer input = {file.data, file.size, 0};
+    size_t ret = 0;
+
+    while(input.pos < input.size) {
+        ZSTD_outBuffer output = {out.data(), out.size(), 0};
+        ret = ZSTD_decompressStream(context.get(), &output, &input);
+
+        if(ZSTD_isError(ret)) {
+            throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(ret));
+        }
 
-        csr.val[dest] = coo.Aj[n];
-        csr.ptr[row]++;
+        if(output.pos > 0 && !sink(out.data(), output.pos)) return;
     }
 
-    for(size_t i = 0, last = 0; i <= coo.n; i++) {
-        size_t temp = csr.ptr[i];
-        csr.ptr[i] = last;
-        last = temp;
+    // a frame is complete once it asks for no more input
+    if(ret != 0) {
+        throw std::runtime_error("zstd: the file is truncated");
     }
 }
+#endif
 
-void coo_tocsc(const Coo_matrix& coo, Sparse_matrix& csc) {
-    csc.n = coo.n;
-    csc.nnz = coo.nnz;
-    csc.ptr.resize(coo.n + 1);
-    csc.val.resize(coo.nnz);
-    csc.type = Sparse_matrix::CSC;
+/**
+ * @brief Decompresses a whole mapped file, piece by piece, without writing the text anywhere
+ * @param file the mapped compressed file
+ * @param compression its compression
+ * @param sink gets the decompressed bytes in order
+ * @return (void)
+ */
+static void decode_file(const Mapped_file& file, const Compression compression, const Decode_sink& sink) {
+    // the whole file is read front to back once
+    if(file.size > 0) madvise((void*) file.data, file.size, MADV_SEQUENTIAL);
+
+    switch(compression) {
+#ifdef SCC_HAVE_ZLIB
+        case GZIP: decode_gzip(file, sink); return;
+#endif
+#ifdef SCC_HAVE_LZMA
+        case XZ: decode_xz(file, sink); return;
+#endif
+#ifdef SCC_HAVE_ZSTD
+        case ZSTD: decode_zstd(file, sink); return;
+#endif
+        case UNCOMPRESSED: sink(file.data, file.size); return;
+        default: break;
+    }
+
+    const char* names[] = {"uncompressed", "gzip", "xz", "zstd"};
+    throw std::runtime_error(std::string("this build has no ") + names[compression] + " support");
+}
+
+/**
+ * @brief How the entries of a text file are laid out, read from its header
+ */
+struct Text_layout {
+    Graph_format format = MATRIX_MARKET;
+    Matrix_size size;
+
+    // SNAP edge lists have no header, their size is found by the first pass
+    bool size_known = true;
+
+    // METIS: a line may start with the size and the weights of its vertex, and every neighbor may have a weight
+    bool vertex_sizes = false;
+    size_t vertex_weights = 0;
+    bool edge_weights = false;
+};
+
+static inline const char* skip_word(const char* p, const char* end) {
+    p = skip_blanks(p, end);
+    while(p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') p++;
+    return p;
+}
+
+/**
+ * @brief Skips the comments of a METIS file and parses its header: "vertices edges [fmt [ncon]]", where fmt is
+ * up to three binary digits telling if there are vertex sizes, vertex weights and edge weights
+ * @param p the start of the file
+ * @param end the end of the file
+ * @param layout the size and the line layout that were read
+ * @return the start of the line of the first vertex
+ */
+static const char* parse_metis_header(const char* p, const char* end, Text_layout& layout) {
+    while(p < end && *p == '%') p = skip_line(p, end);
+
+    size_t n = 0, m = 0;
+    std::string fmt, ncon;
+    p = skip_blanks(p, end);
+    p = parse_index(p, end, n);
+    p = skip_blanks(p, end);
+    p = parse_index(p, end, m);
+    p = parse_word(p, end, fmt);
+    p = parse_word(p, end, ncon);
+
+    if(fmt.size() > 3 || fmt.find_first_not_of("01") != std::string::npos) {
+        throw std::runtime_error("unknown METIS fmt: " + fmt);
+    }
+    fmt.insert(0, 3 - fmt.size(), '0');
+
+    layout.vertex_sizes = fmt[0] == '1';
+    layout.vertex_weights = fmt[1] == '1' ? (ncon.empty() ? 1 : std::stoul(ncon)) : 0;
+    layout.edge_weights = fmt[2] == '1';
+
+    // every undirected edge is in the lists of both of its ends
+    layout.size.rows = n;
+    layout.size.cols = n;
+    layout.size.nnz = 2 * m;
+
+    return skip_line(p, end);
+}
+
+/**
+ * @brief Parses the header of a text file of any format
+ * @param format the format of the file
+ * @param p the start of the file
+ * @param end the end of the file
+ * @return the layout of the entries and the start of the first one
+ */
+static std::pair<Text_layout, const char*> parse_text_header(const Graph_format format, const char* p, const char* end) {
+    Text_layout layout;
+    layout.format = format;
+
+    if(format == MATRIX_MARKET) {
+        p = parse_header(p, end, layout.size);
+    } else if(format == METIS) {
+        p = parse_metis_header(p, end, layout);
+    } else {
+        layout.size_known = false;
+    }
+    return {layout, p};
+}
+
+/**
+ * @brief Finds the end of the header of a text that may be cut anywhere
+ * @param format the format of the text
+ * @param p the start of the text
+ * @param end the end of the text so far
+ * @return the start of the first entry, or nullptr if the header is not complete yet
+ */
+static const char* header_end(const Graph_format format, const char* p, const char* end) {
+    if(format == SNAP) return p;
+
+    while(p < end) {
+        const char* newline = (const char*) std::memchr(p, '\n', end - p);
+        if(newline == nullptr) return nullptr;
+
+        // the banner and the comments start with %, the first other line is the size line
+        if(*p != '%') return newline + 1;
+        p = newline + 1;
+    }
+    return nullptr;
+}
+
+// Galois .gr binary CSR: this header, the end offset of the list of every vertex as uint64, the neighbors as uint32
+// for version 1 or uint64 for version 2, then edge data that is not needed here
+struct Galois_header {
+    uint64_t version;
+    uint64_t edge_data_size;
+    uint64_t n;
+    uint64_t m;
+};
+
+static bool is_galois_gr(const Mapped_file& file) {
+    if(file.size < sizeof(Galois_header)) return false;
+
+    const Galois_header* header = (const Galois_header*) file.data;
+    if(header->version != 1 && header->version != 2) return false;
+    if(header->n > file.size / 8 || header->m > file.size / 4) return false;
+
+    const size_t neighbor_size = header->version == 1 ? sizeof(uint32_t) : sizeof(uint64_t);
+    return file.size >= sizeof(Galois_header) + header->n * sizeof(uint64_t) + header->m * neighbor_size;
+}
+
+/**
+ * @brief Picks the format of a graph file: by its extension (after a .gz/.xz/.zst) if it is a known one, else by
+ * sniffing the start of the file. A MatrixMarket banner, a valid .gr header and a SNAP style # comment are
+ * recognized, a first line of three numbers is read as MatrixMarket without a banner and anything else as a SNAP
+ * edge list. METIS files have no marker and are only found by their extension.
+ * @param filename the name of the file
+ * @param file the mapped file
+ * @param compression its compression
+ * @return the format of the file
+ */
+static Graph_format detect_format(const std::string& filename, const Mapped_file& file, const Compression compression) {
+    const std::string name = stripCompressionExtension(filename);
+    const std::string extension = name.find_last_of("./") != std::string::npos && name[name.find_last_of("./")] == '.'
+                                  ? name.substr(name.find_last_of('.')) : "";
+
+    if(extension == ".mtx") return MATRIX_MARKET;
+    if(extension == ".txt" || extension == ".tsv" || extension == ".el" || extension == ".edges" || extension == ".snap") return SNAP;
+    if(extension == ".graph" || extension == ".metis") return METIS;
+    if(extension == ".gr") return GALOIS_GR;
+
+    if(compression == UNCOMPRESSED && is_galois_gr(file)) return GALOIS_GR;
+
+    // only the start of the file is looked at
+    std::string text;
+    decode_file(file, compression, [&](const char* data, const size_t count) {
+        text.append(data, std::min<size_t>(count, (64 << 10) - text.size()));
+        return text.size() < (64 << 10);
+    });
+
+    const char* p = text.data();
+    const char* end = text.data() + text.size();
+
+    if(text.rfind("%%MatrixMarket", 0) == 0) return MATRIX_MARKET;
+
+    while(p < end && (*p == '%' || *p == '#' || *p == '\n' || *p == '\r')) {
+        if(*p == '#') return SNAP;
+        p = skip_line(p, end);
+    }
+
+    size_t fields = 0;
+    for(const char* q = skip_blanks(p, end); q < end && *q != '\n' && *q != '\r'; q = skip_blanks(q, end)) {
+        q = skip_word(q, end);
+        fields++;
+    }
+    return fields == 3 ? MATRIX_MARKET : SNAP;
+}
+
+Graph_format graphFormatOf(const std::string filename) {
+    Mapped_file file(filename);
+    return detect_format(filename, file, compression_of(file));
+}
+
+const char* graphFormatName(const Graph_format format) {
+    const char* names[] = {"MatrixMarket", "SNAP edge list", "METIS", "Galois gr"};
+    return names[format];
+}
+
+/**
+ * @brief Splits [begin, end) into chunks that start at the beginning of a line
+ * @param begin the start of the text
+ * @param end the end of the text
+ * @param chunks the number of chunks
+ * @return the chunks + 1 boundaries of the chunks
+ */
+static std::vector<const char*> split_lines(const char* begin, const char* end, const size_t chunks) {
+    std::vector<const char*> bounds(chunks + 1);
+    const size_t length = end - begin;
+
+    bounds[0] = begin;
+    for(size_t c = 1; c < chunks; c++) {
+        const char* p = begin + c * length / chunks;
+        // move to the start of the next line, unless already at one
+        if(p[-1] != '\n') p = skip_line(p, end);
+        bounds[c] = std::max(p, bounds[c - 1]);
+    }
+    bounds[chunks] = end;
+
+    return bounds;
+}
+
+// the lines of [begin, end) that are not comments, each is one vertex in a METIS file
+static size_t count_vertex_lines(const char* begin, const char* end) {
+    size_t lines = 0;
+    for(const char* p = begin; p < end; p = skip_line(p, end)) {
+        lines += *p != '%';
+    }
+    return lines;
+}
+
+/**
+ * @brief Calls f(i, j) for every edge of the lines in [begin, end), in file order, whatever the format:
+ * - MatrixMarket: "i j [value]" lines, for symmetric matrices the mirrored edge (j, i) of an entry off the diagonal
+ *   comes right after it
+ * - SNAP: "u v" lines, 0 based, comments start with #
+ * - METIS: the line of vertex v lists its neighbors, 1 based
+ * @param begin the start of the first line
+ * @param end the end of the last line
+ * @param layout the layout of the entries
+ * @param first_vertex METIS only: the number of vertices in the lines before begin
+ * @param f called with the 1 based row and column of every edge
+ * @return (void)
+ */
+template <typename F>
+static void for_each_edge(const char* begin, const char* end, const Text_layout& layout, const size_t first_vertex, F&& f) {
+    size_t i, j;
+    bool is_entry;
+
+    if(layout.format == METIS) {
+        size_t v = first_vertex;
+        for(const char* q = begin; q < end; q = skip_line(q, end)) {
+            if(*q == '%') continue;
+            v++;
+
+            if(layout.vertex_sizes) q = skip_word(q, end);
+            for(size_t w = 0; w < layout.vertex_weights; w++) q = skip_word(q, end);
+
+            while(true) {
+                q = skip_blanks(q, end);
+                if(q == end || !is_digit(*q)) break;
+
+                q = parse_index(q, end, j);
+                f(v, j);
+                if(layout.edge_weights) q = skip_word(q, end);
+            }
+        }
+        return;
+    }
+
+    // SNAP ids start from 0, they are moved to 1 like the other formats
+    const size_t shift = layout.format == SNAP;
+    const bool symmetric = layout.size.symmetric;
+
+    for(const char* q = begin; q < end;) {
+        q = parse_entry(q, end, i, j, is_entry);
+        if(!is_entry) continue;
 
-    std::fill(csc.ptr.begin(), csc.ptr.end(), 0);
+        i += shift;
+        j += shift;
+        f(i, j);
+        if(symmetric && i != j) f(j, i);
+    }
+}
+
+// what the first pass finds in a chunk of a text file, the rows and columns are 1 based
+struct Chunk_summary {
+    size_t edges = 0;
+    size_t diagonal = 0;
+    size_t first_row = std::numeric_limits<size_t>::max();
+    size_t last_row = 0;
+    size_t first_col = std::numeric_limits<size_t>::max();
+    size_t last_col = 0;
+
+    void add(const size_t i, const size_t j) {
+        edges++;
+        diagonal += i == j;
+        first_row = std::min(first_row, i);
+        last_row = std::max(last_row, i);
+        first_col = std::min(first_col, j);
+        last_col = std::max(last_col, j);
+    }
+};
+
+// the size of a text graph once every chunk is summarized
+struct Graph_extent {
+    size_t n;
+    size_t nnz;
+};
+
+/**
+ * @brief Checks the summaries of the chunks of a text file against its header, and finds its size
+ * @param filename the name of the file, for the errors
+ * @param layout the layout read from the header
+ * @param summaries the summary of every chunk
+ * @return the vertices and edges of the graph
+ */
+static Graph_extent check_summaries(const std::string& filename, const Text_layout& layout, const std::vector<Chunk_summary>& summaries) {
+    size_t edges = 0, diagonal = 0, min_index = std::numeric_limits<size_t>::max(), max_index = 0;
+    for(const Chunk_summary& summary : summaries) {
+        edges += summary.edges;
+        diagonal += summary.diagonal;
+        if(summary.edges == 0) continue;
+
+        min_index = std::min({min_index, summary.first_row, summary.first_col});
+        max_index = std::max({max_index, summary.last_row, summary.last_col});
+    }
+
+    // the matrix is used as a graph, so it has to be square
+    const size_t n = layout.size_known ? std::max(layout.size.rows, layout.size.cols) : max_index;
+    if(min_index == 0 || max_index > n) {
+        throw std::runtime_error(filename + ": entry index out of range");
+    }
+
+    if(layout.size_known) {
+        // every entry off the diagonal of a symmetric matrix gave two edges
+        const size_t entries = layout.size.symmetric ? (edges + diagonal) / 2 : edges;
+        if(entries != layout.size.nnz) {
+            throw std::runtime_error(filename + ": found " + std::to_string(entries) + " entries instead of " + std::to_string(layout.size.nnz));
+        }
+    }
+
+    return {n, edges};
+}
+
+/**
+ * @brief A mapped text file split into one chunk of lines per worker, with the first pass done: every chunk is
+ * parsed in parallel to count its edges and find its row and column range.
+ */
+struct Text_chunks {
+    Text_layout layout;
+    std::vector<const char*> bounds;
+    // METIS: the vertices before each chunk
+    std::vector<size_t> first_vertex;
+    std::vector<Chunk_summary> summaries;
+    Graph_extent extent;
+
+    size_t size() const { return summaries.size(); }
+
+    // calls f(i, j) for every edge of chunk c, 1 based
+    template <typename F>
+    void for_each_edge(const size_t c, F&& f) const {
+        ::for_each_edge(bounds[c], bounds[c + 1], layout, first_vertex[c], f);
+    }
+};
+
+// the most chunks split_text splits a file into
+static size_t max_text_chunks() {
+    return std::max<size_t>(1, num_workers());
+}
+
+/**
+ * @brief Splits a mapped text file into chunks and does the first pass, see Text_chunks
+ * @param file the mapped file
+ * @param format its format
+ * @param filename the name of the file, for the errors
+ * @param first_pass_edge first_pass_edge(c, i, j) is also called for every edge of chunk c during the first pass, so
+ * work that only needs the edges is done while the chunk is read the first time
+ * @return the split file
+ */
+template <typename F>
+static Text_chunks split_text(const Mapped_file& file, const Graph_format format, const std::string& filename, F&& first_pass_edge) {
+    const char* file_end = file.data + file.size;
+
+    // the file is read front to back by every thread in its own chunk
+    if(file.size > 0) madvise((void*) file.data, file.size, MADV_SEQUENTIAL);
+
+    Text_chunks text;
+    const char* p;
+    std::tie(text.layout, p) = parse_text_header(format, file.data, file_end);
+
+    const size_t chunks = std::max<size_t>(1, std::min(max_text_chunks(), (size_t)(file_end - p) / 4096));
+    text.bounds = split_lines(p, file_end, chunks);
+    text.first_vertex.assign(chunks + 1, 0);
+    text.summaries.resize(chunks);
+
+    // the vertex of a METIS line is its position, so the lines before every chunk are counted first
+    if(format == METIS) {
+        parallel_for(0, chunks, [&](size_t c) {
+            text.first_vertex[c] = count_vertex_lines(text.bounds[c], text.bounds[c + 1]);
+        });
+        parallel_exclusive_scan(text.first_vertex.data(), chunks + 1);
+    }
+
+    parallel_for(0, chunks, [&](size_t c) {
+        Chunk_summary summary;
+        text.for_each_edge(c, [&](const size_t i, const size_t j) {
+            summary.add(i, j);
+            first_pass_edge(c, i, j);
+        });
+        text.summaries[c] = summary;
+    });
+
+    text.extent = check_summaries(filename, text.layout, text.summaries);
+    return text;
+}
+
+static Text_chunks split_text(const Mapped_file& file, const Graph_format format, const std::string& filename) {
+    return split_text(file, format, filename, [](size_t, size_t, size_t) {});
+}
+
+/**
+ * @brief A queue of at most capacity items, push waits while it is full and pop while it is empty. Connects the
+ * decode thread to the parse threads, so the decoded text that is not parsed yet stays bounded.
+ */
+template <typename T>
+class Bounded_queue {
+public:
+    Bounded_queue(const size_t capacity) : capacity(capacity) {}
+
+    void push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
 
-    for(size_t n = 0; n < coo.nnz; n++) {
-        csc.ptr[coo.Aj[n]]++;
+    // false once the queue is closed and empty
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return !items.empty() || closed; });
+        if(items.empty()) return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
     }
 
-    for(size_t i = 0, cumsum = 0; i < coo.n; i++) {
-        size_t temp = csc.ptr[i];
-        csc.ptr[i] = cumsum;
-        cumsum += temp;
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    const size_t capacity;
+    bool closed = false;
+};
+
+// a piece of the decoded text that ends at a line end, index is its position in the file
+struct Text_buffer {
+    size_t index = 0;
+    std::vector<char> text;
+};
+
+
+template <typename VertexT>
+struct Parsed_buffer {
+    size_t index = 0;
+    // METIS: the vertices of the buffer, its edges are numbered from 1 until the vertices before it are known
+    size_t lines = 0;
+    Chunk_summary summary;
+    std::vector<VertexT> Ai;
+    std::vector<VertexT> Aj;
+};
+
+/**
+ * @brief Loads a compressed text graph into COO. One thread decodes the file and cuts the text into buffers
+ * that end at a line end, the buffers go through a Bounded_queue to the parse threads, so decoding and parsing
+ * overlap and the text is never stored whole. The parsed buffers are put back in file order at the end.
+ * @param file the mapped compressed file
+ * @param compression its compression
+ * @param format the format of the text
+ * @param filename the name of the file, for the errors
+ * @return the matrix in COO format, 0 based, with symmetric entries expanded
+ */
+template <typename VertexT>
+static Coo_matrix<VertexT> load_compressed_coo(const Mapped_file& file, const Compression compression, const Graph_format format,
+                                               const std::string& filename) {
+    if(format == GALOIS_GR) {
+        throw std::runtime_error(filename + ": binary graphs can not be read compressed");
     }
-    csc.ptr[coo.n] = coo.nnz;
 
-    for(size_t n = 0; n < coo.nnz; n++) {
-        size_t col = coo.Aj[n];
-        size_t dest = csc.ptr[col];
+    const size_t workers = std::max<size_t>(1, num_workers());
+    Bounded_queue<Text_buffer> queue(2 * workers);
+
+    // written by the decode thread before the first push, so every parse thread sees it
+    Text_layout layout;
+    std::exception_ptr decode_error;
+
+    std::thread decoder([&] {
+        try {
+            std::vector<char> pending;
+            size_t index = 0;
+            bool header_done = false;
+
+            // hands all whole lines of pending to the parse threads, the last partial line stays
+            auto push_lines = [&](const bool last) {
+                size_t cut = pending.size();
+                if(!last) {
+                    while(cut > 0 && pending[cut - 1] != '\n') cut--;
+                    if(cut == 0) return;
+                }
+
+                std::vector<char> tail(pending.begin() + cut, pending.end());
+                pending.resize(cut);
+                queue.push(Text_buffer{index++, std::move(pending)});
+                pending = std::move(tail);
+                pending.reserve(2 * STREAM_BUFFER_SIZE);
+            };
+
+            auto parse_pending_header = [&] {
+                const char* body = header_end(format, pending.data(), pending.data() + pending.size());
+                if(body == nullptr) return;
+
+                layout = parse_text_header(format, pending.data(), body).first;
+                pending.erase(pending.begin(), pending.begin() + (body - pending.data()));
+                header_done = true;
+            };
+
+            decode_file(file, compression, [&](const char* data, const size_t count) {
+                pending.insert(pending.end(), data, data + count);
+
+                if(!header_done) parse_pending_header();
+                if(header_done && pending.size() >= STREAM_BUFFER_SIZE) push_lines(false);
+                return true;
+            });
+
+            // the size line may be the last line, without a line end
+            if(!header_done) {
+                pending.push_back('\n');
+                parse_pending_header();
+                if(!header_done) throw std::runtime_error("no size line");
+            }
+            if(!pending.empty()) push_lines(true);
+        } catch(...) {
+            decode_error = std::current_exception();
+        }
+        queue.close();
+    });
+
+    // every worker parses buffers until the decoder is done, so it also works if the workers run one after the other
+    std::vector<std::vector<Parsed_buffer<VertexT>>> worker_buffers(workers);
+    parallel_for(0, workers, [&](size_t w) {
+        Text_buffer buffer;
+        while(queue.pop(buffer)) {
+            const char* begin = buffer.text.data();
+            const char* end = buffer.text.data() + buffer.text.size();
 
-        csc.val[dest] = coo.Ai[n];
-        csc.ptr[col]++;
+            Parsed_buffer<VertexT> parsed;
+            parsed.index = buffer.index;
+            if(format == METIS) parsed.lines = count_vertex_lines(begin, end);
+
+            for_each_edge(begin, end, layout, 0, [&](const size_t i, const size_t j) {
+                parsed.summary.add(i, j);
+                parsed.Ai.push_back(i - 1);
+                parsed.Aj.push_back(j - 1);
+            });
+            worker_buffers[w].push_back(std::move(parsed));
+        }
+    });
+    decoder.join();
+
+    if(decode_error) {
+        try {
+            std::rethrow_exception(decode_error);
+        } catch(const std::exception& e) {
+            throw std::runtime_error(filename + ": " + e.what());
+        }
     }
 
-    for(size_t i = 0, last = 0; i <= coo.n; i++) {
-        size_t temp = csc.ptr[i];
-        csc.ptr[i] = last;
-        last = temp;
+    std::vector<Parsed_buffer<VertexT>> buffers;
+    for(auto& worker : worker_buffers) {
+        std::move(worker.begin(), worker.end(), std::back_inserter(buffers));
     }
-}
\ No newline at end of file
+    std::sort(buffers.begin(), buffers.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+
+    // METIS: the rows of every buffer move past the vertices of the buffers before it
+    std::vector<size_t> first_vertex(buffers.size() + 1, 0);
+    for(size_t b = 0; b < buffers.size(); b++) {
+        first_vertex[b + 1] = first_vertex[b] + buffers[b].lines;
+        if(buffers[b].summary.edges > 0) {
+            buffers[b].summary.first_row += first_vertex[b];
+            buffers[b].summary.last_row += first_vertex[b];
+        }
+    }
+
+    std::vector<Chunk_summary> summaries(buffers.size());
+    std::vector<size_t> offsets(buffers.size() + 1, 0);
+    for(size_t b = 0; b < buffers.size(); b++) {
+        summaries[b] = buffers[b].summary;
+        offsets[b] = buffers[b].Ai.size();
+    }
+
+    const Graph_extent extent = check_summaries(filename, layout, summaries);
+    if(extent.n >= std::numeric_limits<VertexT>::max()) {
+        throw std::runtime_error(filename + ": too large for the chosen index width");
+    }
+    parallel_exclusive_scan(offsets.data(), buffers.size() + 1);
+
+    Numa_vector<VertexT> Ai(extent.nnz);
+    Numa_vector<VertexT> Aj(extent.nnz);
+    parallel_for(0, buffers.size(), [&](size_t b) {
+        const VertexT shift = first_vertex[b];
+        std::transform(buffers[b].Ai.begin(), buffers[b].Ai.end(), Ai.begin() + offsets[b], [&](VertexT i) { return i + shift; });
+        std::copy(buffers[b].Aj.begin(), buffers[b].Aj.end(), Aj.begin() + offsets[b]);
+        buffers[b] = Parsed_buffer<VertexT>();
+    });
+
+    // automatically moves the vectors, no copying is done here
+    return Coo_matrix<VertexT>{extent.n, extent.nnz, std::move(Ai), std::move(Aj)};
+}
+
+// the histograms of all the blocks of parallel_scatter (the chunks of scatter_text) hold at most this many times n
+// counts, with more blocks the keys are split into ranges that take one pass over the entries each
+#define SCATTER_HISTOGRAM_FACTOR 8
+
+/**
+ * @brief The number of entries of every key in a range of keys. The range is either set from the first pass, or grows
+ * to fit the keys as they are added, doubling towards the side of the new key.
+ */
+struct Key_counts {
+    size_t first = 0;
+    std::vector<size_t> count;
+    // the first pass stopped counting, the range grew past its share of the histograms
+    bool dropped = false;
+
+    void set_range(const size_t first_key, const size_t last_key) {
+        first = first_key;
+        count.assign(last_key - first_key + 1, 0);
+    }
+
+    void clear() {
+        first = 0;
+        count = std::vector<size_t>();
+    }
+
+    bool contains(const size_t key) const { return key >= first && key - first < count.size(); }
+
+    void add(const size_t key) {
+        if(count.empty()) {
+            set_range(key, key);
+        } else if(key < first) {
+            const size_t grow = std::max(first - key, std::min(first, count.size()));
+            count.insert(count.begin(), grow, 0);
+            first -= grow;
+        } else if(key - first >= count.size()) {
+            count.resize(std::max(key - first + 1, 2 * count.size()), 0);
+        }
+        count[key - first]++;
+    }
+};
+
+/**
+ * @brief The state of one output (CSC or CSR) of the chunked loader. For CSC an entry (i, j) is placed in
+ * column j with value i, for CSR in row i with value j.
+ */
+template <typename Matrix>
+struct Scatter_side {
+    bool by_column;
+
+    // the number of entries of each key (column for CSC, row for CSR) in the range of each chunk, turned into offsets
+    // before the scatter
+    std::vector<Key_counts> chunk_counts;
+    // the counts are complete, either from the first pass or from scatter_text
+    bool counted = false;
+    // made by transposing the other side instead of scattering the text
+    bool transposed = false;
+
+    Index_array<typename Matrix::Offset> ptr;
+    Index_array<typename Matrix::Vertex> val;
+
+    // both are 1 based, as in the file
+    size_t key(const size_t i, const size_t j) const { return (by_column ? j : i) - 1; }
+    size_t value(const size_t i, const size_t j) const { return (by_column ? i : j) - 1; }
+};
+
+/**
+ * @brief The outputs of the chunked loader, counting the entries of every chunk can be done during the first pass
+ * of split_text, see count_edge
+ */
+template <typename Matrix>
+struct Text_scatter {
+    std::vector<Scatter_side<Matrix>> sides;
+    // the entries were counted by the first pass
+    bool counted = false;
+    // one past the largest key counted by any chunk so far, the histograms of the first pass may take
+    // SCATTER_HISTOGRAM_FACTOR times this
+    std::atomic<size_t> key_end{0};
+
+    Text_scatter(const bool make_csc, const bool make_csr) {
+        if(make_csc) sides.push_back({true});
+        if(make_csr) sides.push_back({false});
+        for(auto& side : sides) {
+            side.chunk_counts.resize(max_text_chunks());
+        }
+    }
+
+    // for the first pass of split_text, every chunk only touches its own counts. A chunk whose range outgrows its share
+    // of the histograms, as the columns of a file sorted by row do, drops its counts and scatter_text counts that side
+    // again, so the first pass never holds a histogram of n for every chunk
+    void count_edge(const size_t c, const size_t i, const size_t j) {
+        for(auto& side : sides) {
+            Key_counts& counts = side.chunk_counts[c];
+            if(counts.dropped) continue;
+
+            const size_t size = counts.count.size();
+            counts.add(side.key(i, j));
+            if(counts.count.size() == size) continue;
+
+            const size_t end = counts.first + counts.count.size();
+            size_t seen = key_end.load(std::memory_order_relaxed);
+            while(end > seen && !key_end.compare_exchange_weak(seen, end, std::memory_order_relaxed)) {}
+            if(counts.count.size() * side.chunk_counts.size() > SCATTER_HISTOGRAM_FACTOR * std::max(end, seen)) {
+                counts.clear();
+                counts.dropped = true;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Scatters the edges of a split text file into CSC, CSR or both. Every chunk counts the entries of each
+ * column/row in its own range and then scatters its entries into place. When both are made every entry is
+ * scattered into both, so there is no transpose. The entries of a column/row keep their order in the file.
+ * The ranges of all the chunks are bounded like the histograms of parallel_scatter, see SCATTER_HISTOGRAM_FACTOR.
+ * A side whose ranges are wider, the columns of a file sorted by row, is transposed from the other side when that one
+ * fits, its entries are then sorted by row instead of in file order. Otherwise its keys are split into ranges that
+ * take two passes over the text each, and the degrees are only given at the end.
+ * A matrix whose ptr and val already have the right sizes, like views into a writable mapped file, is written in place.
+ * @param text the split file, with its first pass done
+ * @param scatter the outputs, their entries may already be counted by the first pass
+ * @param csc where the CSC matrix is placed, or nullptr if it is not in scatter
+ * @param csr where the CSR matrix is placed, or nullptr if it is not in scatter
+ * @param on_degrees if given, it runs on its own thread during the scatter, see Degrees_ready
+ * @return (void)
+ */
+template <typename Matrix>
+static void scatter_text(const Text_chunks& text, Text_scatter<Matrix>& scatter, Matrix* csc, Matrix* csr,
+                         const Degrees_ready<typename Matrix::Offset>& on_degrees) {
+    const size_t n = text.extent.n;
+    const size_t nnz = text.extent.nnz;
+    const size_t chunks = text.size();
+    auto& sides = scatter.sides;
+
+    for(auto& side : sides) {
+        Matrix& matrix = side.by_column ? *csc : *csr;
+        const bool in_place = matrix.ptr.size() == n + 1 && matrix.val.size() == nnz;
+        side.ptr = in_place ? std::move(matrix.ptr) : Index_array(Numa_vector<typename Matrix::Offset>(n + 1));
+        side.val = in_place ? std::move(matrix.val) : Index_array(Numa_vector<typename Matrix::Vertex>(nnz));
+    }
+
+    // the length of the histograms of every side, the counts of the first pass are kept when they fit
+    const size_t budget = SCATTER_HISTOGRAM_FACTOR * std::max<size_t>(n, 1);
+    std::vector<size_t> spans(sides.size(), 0);
+    for(size_t s = 0; s < sides.size(); s++) {
+        Scatter_side<Matrix>& side = sides[s];
+        side.ptr[n] = 0;
+        if(scatter.counted) {
+            side.counted = true;
+            for(const Key_counts& counts : side.chunk_counts) {
+                side.counted = side.counted && !counts.dropped;
+                spans[s] += counts.count.size();
+            }
+            side.counted = side.counted && spans[s] <= budget;
+            if(side.counted) continue;
+            spans[s] = 0;
+        }
+
+        for(size_t c = 0; c < chunks; c++) {
+            const Chunk_summary& summary = text.summaries[c];
+            side.chunk_counts[c].clear();
+            if(summary.edges == 0) continue;
+            spans[s] += side.by_column ? summary.last_col - summary.first_col + 1 : summary.last_row - summary.first_row + 1;
+        }
+    }
+    // a side that does not fit is transposed from the other one when that fits
+    if(sides.size() == 2) {
+        for(size_t s = 0; s < 2; s++) {
+            sides[s].transposed = spans[s] > budget && spans[1 - s] <= budget;
+        }
+    }
+    // the sides scattered from the text share every pass, they only need more than one when none of them fits
+    size_t passes = 1;
+    for(size_t s = 0; s < sides.size(); s++) {
+        if(!sides[s].transposed) passes = std::max(passes, (spans[s] + budget - 1) / budget);
+    }
+    const size_t range = (n + passes - 1) / passes;
+
+    // the degrees can be given during the scatter when all the offsets are known before it
+    const bool early_degrees = passes == 1 && std::none_of(sides.begin(), sides.end(),
+                                                           [](const auto& side) { return side.transposed; });
+    std::thread degrees_thread;
+    auto give_degrees = [&]() {
+        if(!on_degrees) return;
+        const auto* in_ptr = csc != nullptr ? sides.front().ptr.data() : nullptr;
+        const auto* out_ptr = csr != nullptr ? sides.back().ptr.data() : nullptr;
+        degrees_thread = std::thread([&on_degrees, n, in_ptr, out_ptr]() { on_degrees(n, in_ptr, out_ptr); });
+    };
+
+    // the entries of the keys of the ranges before, for every side
+    std::vector<size_t> start(sides.size(), 0);
+    for(size_t first = 0; first < n; first += range) {
+        const size_t keys = std::min(range, n - first);
+
+        // every chunk counts the entries of each column (and row) in its own range, clipped to the keys of this pass
+        // for files sorted by column, as in the SuiteSparse collection, the column ranges barely overlap
+        parallel_for(0, chunks, [&](size_t c) {
+            const Chunk_summary& summary = text.summaries[c];
+            if(summary.edges == 0) return;
+
+            bool any = false;
+            for(auto& side : sides) {
+                if(side.counted || side.transposed) continue;
+                const size_t low = std::max((side.by_column ? summary.first_col : summary.first_row) - 1, first);
+                const size_t high = std::min((side.by_column ? summary.last_col : summary.last_row) - 1, first + keys - 1);
+                if(low <= high) {
+                    side.chunk_counts[c].set_range(low, high);
+                    any = true;
+                } else {
+                    side.chunk_counts[c].clear();
+                }
+            }
+            if(!any) return;
+
+            text.for_each_edge(c, [&](const size_t i, const size_t j) {
+                for(auto& side : sides) {
+                    Key_counts& counts = side.chunk_counts[c];
+                    const size_t key = side.key(i, j);
+                    if(!side.counted && counts.contains(key)) counts.count[key - counts.first]++;
+                }
+            });
+        });
+
+        // the degree of each column (row), and the offset of each chunk inside each column (row)
+        for(size_t s = 0; s < sides.size(); s++) {
+            Scatter_side<Matrix>& side = sides[s];
+            if(side.transposed) continue;
+
+            parallel_for(first, first + keys, [&](size_t key) {
+                size_t degree = 0;
+                for(size_t c = 0; c < chunks; c++) {
+                    Key_counts& counts = side.chunk_counts[c];
+                    if(!counts.contains(key)) continue;
+
+                    size_t& count = counts.count[key - counts.first];
+                    size_t temp = count;
+                    count = degree;
+                    degree += temp;
+                }
+                side.ptr[key] = degree;
+            });
+
+            const size_t range_entries = parallel_exclusive_scan(side.ptr.data() + first, keys);
+            parallel_for(first, first + keys, [&](size_t key) {
+                side.ptr[key] += start[s];
+            });
+            start[s] += range_entries;
+            side.ptr[n] = start[s];
+        }
+
+        // the scatter below only reads ptr, so the degrees are final from here on
+        if(early_degrees && first == 0) give_degrees();
+
+        // every chunk writes to its own slots of each column (row), the counts only hold the keys of this pass
+        parallel_for(0, chunks, [&](size_t c) {
+            if(text.summaries[c].edges == 0) return;
+
+            text.for_each_edge(c, [&](const size_t i, const size_t j) {
+                for(auto& side : sides) {
+                    Key_counts& counts = side.chunk_counts[c];
+                    const size_t key = side.key(i, j);
+                    if(counts.contains(key)) side.val[side.ptr[key] + counts.count[key - counts.first]++] = side.value(i, j);
+                }
+            });
+        });
+    }
+
+    for(size_t s = 0; s < sides.size(); s++) {
+        sides[s].chunk_counts = std::vector<Key_counts>();
+        if(sides[s].transposed) csr_tocsc(n, sides[1 - s].ptr, sides[1 - s].val, sides[s].ptr, sides[s].val);
+    }
+    if(!degrees_thread.joinable()) give_degrees();
+    if(degrees_thread.joinable()) degrees_thread.join();
+
+    // automatically moves the vectors, no copying is done here
+    for(auto& side : sides) {
+        Matrix& matrix = side.by_column ? *csc : *csr;
+        matrix = Matrix{n, nnz, std::move(side.ptr), std::move(side.val), side.by_column ? Matrix::CSC : Matrix::CSR};
+    }
+}
+
+template <typename Matrix>
+static void scatter_text(const Text_chunks& text, Matrix* csc, Matrix* csr) {
+    Text_scatter<Matrix> scatter(csc != nullptr, csr != nullptr);
+    scatter_text(text, scatter, csc, csr, nullptr);
+}
+
+/**
+ * @brief Loads a Galois .gr file, a binary CSR of the out edges of every vertex, converting it to the index widths
+ * of Matrix in parallel
+ * @param file the mapped file
+ * @param filename the name of the file, for the errors
+ * @return the graph in CSR format
+ */
+template <typename Matrix>
+static Matrix load_galois_gr(const Mapped_file& file, const std::string& filename) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+
+    if(!is_galois_gr(file)) {
+        throw std::runtime_error(filename + ": not a valid Galois .gr file");
+    }
+
+    const Galois_header header = *(const Galois_header*) file.data;
+    const size_t n = header.n;
+    const size_t nnz = header.m;
+
+    if(n >= std::numeric_limits<Vertex>::max() || nnz > std::numeric_limits<Offset>::max()) {
+        throw std::runtime_error(filename + ": too large for the chosen index width");
+    }
+
+    const uint64_t* ends = (const uint64_t*)(file.data + sizeof(Galois_header));
+    const char* neighbors = (const char*)(ends + n);
+
+    Numa_vector<Offset> ptr(n + 1);
+    Numa_vector<Vertex> val(nnz);
+
+    // every block checks its own part, the flags are combined after
+    const size_t blocks = std::max<size_t>(1, num_workers());
+    std::vector<char> block_invalid(blocks, false);
+
+    parallel_for(0, blocks, [&](size_t b) {
+        bool invalid = false;
+        for(size_t v = b * n / blocks; v < (b + 1) * n / blocks; v++) {
+            invalid |= ends[v] > nnz || (v > 0 && ends[v] < ends[v - 1]);
+            ptr[v + 1] = ends[v];
+        }
+        for(size_t k = b * nnz / blocks; k < (b + 1) * nnz / blocks; k++) {
+            const uint64_t u = header.version == 1 ? ((const uint32_t*) neighbors)[k] : ((const uint64_t*) neighbors)[k];
+            invalid |= u >= n;
+            val[k] = u;
+        }
+        block_invalid[b] = invalid;
+    });
+
+    if(std::find(block_invalid.begin(), block_invalid.end(), true) != block_invalid.end() || ptr[n] != nnz) {
+        throw std::runtime_error(filename + ": corrupt Galois .gr file");
+    }
+
+    return Matrix{n, nnz, std::move(ptr), std::move(val), Matrix::CSR};
+}
+
+/**
+ * @brief Loads a graph file of any format into CSC, CSR or both. Text files are split into one chunk per worker and
+ * parsed in parallel, compressed files are streamed by load_compressed_coo and binary files converted in parallel.
+ * Pipelined, when on_degrees is given: text files count the degrees during the first pass, while each chunk is read
+ * from disk, instead of in a pass of their own, and on_degrees overlaps the scatter of the lists. The other formats
+ * call it once they are loaded.
+ * @param filename the graph file
+ * @param csc where the CSC matrix is placed
+ * @param csr where the CSR matrix is placed, or nullptr to not make it
+ * @param on_degrees see Degrees_ready, or nullptr
+ * @return (void)
+ */
+template <typename Matrix>
+static void load_graph(const std::string& filename, Matrix* csc, Matrix* csr, const Degrees_ready<typename Matrix::Offset>& on_degrees) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+
+    Mapped_file file(filename);
+    const Compression compression = compression_of(file);
+    const Graph_format format = detect_format(filename, file, compression);
+
+    // the degrees are only known once these are loaded
+    auto loaded = [&]() {
+        if(on_degrees) on_degrees(csc->n, csc->ptr.data(), csr != nullptr ? csr->ptr.data() : nullptr);
+    };
+
+    if(format == GALOIS_GR && compression == UNCOMPRESSED) {
+        Matrix graph = load_galois_gr<Matrix>(file, filename);
+        csr_tocsc(graph, *csc);
+        if(csr != nullptr) *csr = std::move(graph);
+        loaded();
+        return;
+    }
+
+    // compressed files are streamed into COO and transposed into place
+    if(compression != UNCOMPRESSED) {
+        const Coo_matrix<Vertex> coo = load_compressed_coo<Vertex>(file, compression, format, filename);
+        if(coo.nnz > std::numeric_limits<Offset>::max()) {
+            throw std::runtime_error(filename + ": too large for the chosen index width");
+        }
+        coo_tocsc(coo, *csc);
+        if(csr != nullptr) coo_tocsr(coo, *csr);
+        loaded();
+        return;
+    }
+
+    Text_scatter<Matrix> scatter(true, csr != nullptr);
+    scatter.counted = (bool) on_degrees;
+    const Text_chunks text = scatter.counted
+        ? split_text(file, format, filename, [&](const size_t c, const size_t i, const size_t j) { scatter.count_edge(c, i, j); })
+        : split_text(file, format, filename);
+    if(text.extent.n >= std::numeric_limits<Vertex>::max() || text.extent.nnz > std::numeric_limits<Offset>::max()) {
+        throw std::runtime_error(filename + ": too large for the chosen index width");
+    }
+    scatter_text(text, scatter, csc, csr, on_degrees);
+}
+
+/**
+ * @brief Loads a graph file straight into CSC, in parallel. See load_graph.
+ * @param filename the graph file
+ * @return the matrix in CSC format
+ */
+template <typename Matrix>
+Matrix loadFileToCSC(const std::string filename, const Degrees_ready<typename Matrix::Offset>& on_degrees) {
+    Matrix csc;
+    load_graph<Matrix>(filename, &csc, nullptr, on_degrees);
+    return csc;
+}
+
+/**
+ * @brief Loads a graph file into both CSC and CSR with the same parse passes, instead of loading the CSC
+ * and transposing it. See load_graph.
+ * @param filename the graph file
+ * @param csc where the CSC matrix is placed
+ * @param csr where the CSR matrix is placed
+ * @return (void)
+ */
+template <typename Matrix>
+void loadFileToCSCAndCSR(const std::string filename, Matrix& csc, Matrix& csr, const Degrees_ready<typename Matrix::Offset>& on_degrees) {
+    load_graph<Matrix>(filename, &csc, &csr, on_degrees);
+}
+
+/**
+ * @brief Loads a graph file into COO, in parallel: every chunk counts its edges, then writes them after the
+ * edges of the chunks before it, so the edges are in file order.
+ * @param filename the graph file
+ * @return the matrix in COO format, 0 based
+ */
+template <typename VertexT>
+Coo_matrix<VertexT> loadFileToCoo(const std::string filename) {
+    Mapped_file file(filename);
+    const Compression compression = compression_of(file);
+    const Graph_format format = detect_format(filename, file, compression);
+
+    if(compression != UNCOMPRESSED) {
+        return load_compressed_coo<VertexT>(file, compression, format, filename);
+    }
+
+    if(format == GALOIS_GR) {
+        const Sparse_matrix<VertexT, uint64_t> csr = load_galois_gr<Sparse_matrix<VertexT, uint64_t>>(file, filename);
+
+        Numa_vector<VertexT> Ai(csr.nnz);
+        Numa_vector<VertexT> Aj(csr.nnz);
+        parallel_for(0, csr.n, [&](size_t v) {
+            std::fill(Ai.begin() + csr.ptr[v], Ai.begin() + csr.ptr[v + 1], v);
+            std::copy(csr.val.begin() + csr.ptr[v], csr.val.begin() + csr.ptr[v + 1], Aj.begin() + csr.ptr[v]);
+        });
+        return Coo_matrix<VertexT>{csr.n, csr.nnz, std::move(Ai), std::move(Aj)};
+    }
+
+    const Text_chunks text = split_text(file, format, filename);
+    if(text.extent.n >= std::numeric_limits<VertexT>::max()) {
+        throw std::runtime_error(filename + ": too large for the chosen index width");
+    }
+
+    // the position of the first edge of every chunk
+    std::vector<size_t> offsets(text.size() + 1, 0);
+    for(size_t c = 0; c < text.size(); c++) {
+        offsets[c] = text.summaries[c].edges;
+    }
+    parallel_exclusive_scan(offsets.data(), text.size() + 1);
+
+    Numa_vector<VertexT> Ai(text.extent.nnz);
+    Numa_vector<VertexT> Aj(text.extent.nnz);
+
+    parallel_for(0, text.size(), [&](size_t c) {
+        size_t next = offsets[c];
+        text.for_each_edge(c, [&](const size_t i, const size_t j) {
+            Ai[next] = i - 1;
+            Aj[next] = j - 1;
+            next++;
+        });
+    });
+
+    // automatically moves the vectors, no copying is done here
+    return Coo_matrix<VertexT>{text.extent.n, text.extent.nnz, std::move(Ai), std::move(Aj)};
+}
+
+/**
+ * @brief Reads the size of a graph file without loading it, used to pick the index widths before loading. Only the
+ * header is read, except for SNAP edge lists that have none: they get the first pass of the parallel loader, or a
+ * single threaded scan while decoding when compressed.
+ * @param filename the graph file, it may be compressed
+ * @return the rows, columns and non zeros of the matrix
+ */
+Matrix_size loadFileSize(const std::string filename) {
+    Mapped_file file(filename);
+    const Compression compression = compression_of(file);
+    const Graph_format format = detect_format(filename, file, compression);
+
+    if(format == GALOIS_GR) {
+        if(compression != UNCOMPRESSED || !is_galois_gr(file)) {
+            throw std::runtime_error(filename + ": not a valid Galois .gr file");
+        }
+        const Galois_header* header = (const Galois_header*) file.data;
+        return Matrix_size{header->n, header->n, header->m};
+    }
+
+    if(compression == UNCOMPRESSED) {
+        if(format != SNAP) {
+            return parse_text_header(format, file.data, file.data + file.size).first.size;
+        }
+
+        const Text_chunks text = split_text(file, format, filename);
+        return Matrix_size{text.extent.n, text.extent.n, text.extent.nnz};
+    }
+
+    Text_layout layout;
+    layout.format = format;
+    layout.size_known = false;
+
+    // the decoded text so far, only the last partial line is kept
+    std::string text;
+    Chunk_summary summary;
+
+    decode_file(file, compression, [&](const char* data, const size_t count) {
+        text.append(data, count);
+
+        if(format != SNAP) {
+            return header_end(format, text.data(), text.data() + text.size()) == nullptr;
+        }
+
+        const size_t cut = text.find_last_of('\n') + 1;
+        for_each_edge(text.data(), text.data() + cut, layout, 0, [&](const size_t i, const size_t j) {
+            summary.add(i, j);
+        });
+        text.erase(0, cut);
+        return true;
+    });
+
+    if(format != SNAP) {
+        return parse_text_header(format, text.data(), text.data() + text.size()).first.size;
+    }
+
+    for_each_edge(text.data(), text.data() + text.size(), layout, 0, [&](const size_t i, const size_t j) {
+        summary.add(i, j);
+    });
+    const Graph_extent extent = check_summaries(filename, layout, {summary});
+    return Matrix_size{extent.n, extent.n, extent.nnz};
+}
+
+// on disk layout of the binary cache: this header, then ptr and val, each starting at a page boundary
+#define BINARY_MAGIC "SCCSPMX"
+// 3: the cached graphs are canonicalized, see canonicalizeSparse
+#define BINARY_VERSION 3
+#define BINARY_ALIGNMENT 4096
+#define CHECKSUM_BLOCK (1 << 20)
+
+struct Binary_header {
+    char magic[8];
+    uint32_t version;
+    // the size in bytes of each entry of val
+    uint32_t vertex_width;
+    uint64_t n;
+    uint64_t nnz;
+    // Sparse_matrix::CSC or Sparse_matrix::CSR
+    uint32_t type;
+    // the size in bytes of each entry of ptr
+    uint32_t offset_width;
+    uint64_t ptr_offset;
+    uint64_t val_offset;
+    uint64_t data_checksum;
+    // checksum of all the fields above
+    uint64_t header_checksum;
+};
+
+// FNV-1a over 64 bit words, good enough to catch truncated or stale files
+static inline uint64_t fnv_words(uint64_t hash, const uint64_t* words, const size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        hash = (hash ^ words[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Checksum of an array, computed in parallel over fixed size blocks so it does not depend on the number of workers
+ * @param data the array
+ * @param count the number of elements
+ * @return the checksum
+ */
+template <typename T>
+static uint64_t array_checksum(const T* data, const size_t count) {
+    const uint64_t* words = (const uint64_t*) data;
+    const size_t bytes = count * sizeof(T);
+    const size_t word_count = bytes / sizeof(uint64_t);
+    const size_t blocks = (word_count + CHECKSUM_BLOCK - 1) / CHECKSUM_BLOCK;
+
+    std::vector<uint64_t> block_hash(blocks + 1, 0);
+    parallel_for(0, blocks, [&](size_t b) {
+        const size_t start = b * CHECKSUM_BLOCK;
+        const size_t end = std::min(word_count, start + CHECKSUM_BLOCK);
+        block_hash[b] = fnv_words(0xcbf29ce484222325ULL, words + start, end - start);
+    });
+
+    // an odd number of 32 bit entries leaves a half word at the end
+    std::memcpy(&block_hash[blocks], words + word_count, bytes - word_count * sizeof(uint64_t));
+
+    return fnv_words(0xcbf29ce484222325ULL ^ count, block_hash.data(), blocks + 1);
+}
+
+static uint64_t header_checksum(const Binary_header& header) {
+    return fnv_words(0xcbf29ce484222325ULL, (const uint64_t*) &header, offsetof(Binary_header, header_checksum) / sizeof(uint64_t));
+}
+
+static size_t align_up(const size_t offset) {
+    return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+}
+
+// the header of a matrix of n vertices, without the checksums
+template <typename Matrix>
+static Binary_header binary_header(const size_t n, const size_t nnz, const typename Matrix::CSC_CSR type) {
+    Binary_header header = {};
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.vertex_width = sizeof(typename Matrix::Vertex);
+    header.offset_width = sizeof(typename Matrix::Offset);
+    header.n = n;
+    header.nnz = nnz;
+    header.type = type;
+    header.ptr_offset = align_up(sizeof(Binary_header));
+    header.val_offset = align_up(header.ptr_offset + (n + 1) * sizeof(typename Matrix::Offset));
+    return header;
+}
+
+template <typename Matrix>
+static void set_checksums(Binary_header& header, const Matrix& matrix) {
+    header.data_checksum = array_checksum(matrix.ptr.data(), matrix.n + 1) ^ array_checksum(matrix.val.data(), matrix.nnz);
+    header.header_checksum = header_checksum(header);
+}
+
+/**
+ * @brief Writes a Sparse_matrix to a versioned binary file that loadBinaryToSparse can map without copying.
+ * The file is written under a temporary name and renamed at the end, so a concurrent run never sees half of it.
+ * @param matrix the matrix to save
+ * @param filename the binary file
+ * @return (void)
+ */
+template <typename Matrix>
+void saveSparseToBinary(const Matrix& matrix, const std::string filename) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+
+    Binary_header header = binary_header<Matrix>(matrix.n, matrix.nnz, matrix.type);
+    set_checksums(header, matrix);
+
+    const std::string temp_filename = filename + ".tmp" + std::to_string(getpid());
+    FILE* fout = fopen(temp_filename.c_str(), "wb");
+    if(fout == nullptr) {
+        throw std::runtime_error("Could not create " + temp_filename);
+    }
+
+    const std::vector<char> padding(BINARY_ALIGNMENT, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, fout) == 1;
+    ok = ok && fwrite(padding.data(), 1, header.ptr_offset - sizeof(header), fout) == header.ptr_offset - sizeof(header);
+    ok = ok && fwrite(matrix.ptr.data(), sizeof(Offset), matrix.n + 1, fout) == matrix.n + 1;
+
+    const size_t ptr_end = header.ptr_offset + (matrix.n + 1) * sizeof(Offset);
+    ok = ok && fwrite(padding.data(), 1, header.val_offset - ptr_end, fout) == header.val_offset - ptr_end;
+    ok = ok && fwrite(matrix.val.data(), sizeof(Vertex), matrix.nnz, fout) == matrix.nnz;
+    ok = (fclose(fout) == 0) && ok;
+
+    if(!ok || rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(temp_filename.c_str());
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+/**
+ * @brief Maps a binary file written by saveSparseToBinary. ptr and val point straight into the read only mapping,
+ * so nothing is read until the algorithm touches it.
+ * @param filename the binary file
+ * @param verify_checksum if true, reads the whole file to check the data checksum
+ * @return the matrix, in the format it was saved in
+ */
+template <typename Matrix>
+Matrix loadBinaryToSparse(const std::string filename, const bool verify_checksum) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+
+    auto file = std::make_shared<const Mapped_file>(filename);
+
+    Binary_header header;
+    if(file->size < sizeof(header)) {
+        throw std::runtime_error(filename + ": not a binary sparse matrix");
+    }
+    std::memcpy(&header, file->data, sizeof(header));
+
+    if(std::memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) != 0 || header.header_checksum != header_checksum(header)) {
+        throw std::runtime_error(filename + ": not a binary sparse matrix");
+    }
+    if(header.version != BINARY_VERSION || header.vertex_width != sizeof(Vertex) || header.offset_width != sizeof(Offset)) {
+        throw std::runtime_error(filename + ": unsupported binary version or index width");
+    }
+    if(file->size < header.val_offset + header.nnz * sizeof(Vertex)) {
+        throw std::runtime_error(filename + ": file is truncated");
+    }
+
+    Matrix matrix{header.n, header.nnz,
+                  Index_array<Offset>(file, header.ptr_offset, header.n + 1),
+                  Index_array<Vertex>(file, header.val_offset, header.nnz),
+                  (typename Matrix::CSC_CSR) header.type};
+
+    if(verify_checksum) {
+        Binary_header expected = header;
+        set_checksums(expected, matrix);
+        if(expected.data_checksum != header.data_checksum) {
+            throw std::runtime_error(filename + ": checksum mismatch");
+        }
+    }
+
+    return matrix;
+}
+
+/**
+ * @brief Checks if a binary cache exists and was written after the file it was made from
+ * @param binary_filename the binary file
+ * @param source_filename the file it was made from
+ * @return true if the binary file can be used instead of the source
+ */
+bool isBinaryUpToDate(const std::string binary_filename, const std::string source_filename) {
+    std::error_code error;
+    const auto binary_time = std::filesystem::last_write_time(binary_filename, error);
+    if(error) return false;
+
+    const auto source_time = std::filesystem::last_write_time(source_filename, error);
+    if(error) return false;
+
+    return binary_time >= source_time;
+}
+
+/**
+ * @brief Makes the binary cache of the CSC of a graph file for graphs larger than memory. The cache is made at its
+ * final size and mapped shared, ptr and val are scattered and canonicalized straight into the mapping, so their pages
+ * are written back to disk under memory pressure instead of needing memory or swap. Only the O(n) arrays of the
+ * loader are in memory. Compressed and Galois .gr files are loaded in memory and saved, they need the memory anyway.
+ * @param filename the graph file
+ * @param binary_filename the binary cache, written under a temporary name and renamed at the end
+ * @param canonicalize if true, the adjacency lists are canonicalized, see canonicalizeSparse
+ * @param remove_self_loops if true, the self loops are removed while canonicalizing
+ * @return the number of edges removed while canonicalizing
+ */
+template <typename Matrix>
+size_t loadFileToBinaryCSC(const std::string filename, const std::string binary_filename, const bool canonicalize, const bool remove_self_loops) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+
+    const Mapped_file file(filename);
+    const Compression compression = compression_of(file);
+    const Graph_format format = detect_format(filename, file, compression);
+
+    if(compression != UNCOMPRESSED || format == GALOIS_GR) {
+        Matrix csc;
+        load_graph<Matrix>(filename, &csc, nullptr, nullptr);
+        const size_t removed = canonicalize ? canonicalizeSparse(csc, remove_self_loops) : 0;
+        saveSparseToBinary(csc, binary_filename);
+        return removed;
+    }
+
+    const Text_chunks text = split_text(file, format, filename);
+    const size_t n = text.extent.n;
+    if(n >= std::numeric_limits<Vertex>::max() || text.extent.nnz > std::numeric_limits<Offset>::max()) {
+        throw std::runtime_error(filename + ": too large for the chosen index width");
+    }
+
+    Binary_header header = binary_header<Matrix>(n, text.extent.nnz, Matrix::CSC);
+    const std::string temp_filename = binary_filename + ".tmp" + std::to_string(getpid());
+
+    size_t removed = 0;
+    size_t size = 0;
+    try {
+        auto cache = std::make_shared<const Mapped_file>(temp_filename, header.val_offset + header.nnz * sizeof(Vertex));
+
+        Matrix csc{n, header.nnz, Index_array<Offset>(cache, header.ptr_offset, n + 1),
+                   Index_array<Vertex>(cache, header.val_offset, header.nnz), Matrix::CSC};
+        scatter_text<Matrix>(text, &csc, nullptr);
+        if(canonicalize) removed = canonicalizeSparse(csc, remove_self_loops);
+
+        header.nnz = csc.nnz;
+        set_checksums(header, csc);
+        std::memcpy((void*) cache->data, &header, sizeof(header));
+        size = header.val_offset + header.nnz * sizeof(Vertex);
+    } catch(...) {
+        std::remove(temp_filename.c_str());
+        throw;
+    }
+
+    // the mapping is gone, so the file can drop the edges removed by canonicalizing
+    if(truncate(temp_filename.c_str(), size) != 0 || rename(temp_filename.c_str(), binary_filename.c_str()) != 0) {
+        std::remove(temp_filename.c_str());
+        throw std::runtime_error("Could not write " + binary_filename);
+    }
+    return removed;
+}
+
+/**
+ * @brief Sorts every adjacency list and removes the duplicate edges, and the self loops if asked. Every list is
+ * cleaned in place in parallel, a prefix sum of the new degrees gives the new offsets and then the lists are
+ * packed into a new val in parallel. The CSC and CSR of a matrix stay each other's transpose when both are cleaned.
+ * A matrix in a writable mapping is packed in place instead, in one sequential pass, so there is no second val.
+ * @param matrix the matrix to clean, CSC or CSR, read only mapped arrays are copied into memory first
+ * @param remove_self_loops if true, v is removed from the neighbors of v
+ * @return the number of edges removed
+ */
+template <typename Matrix>
+size_t canonicalizeSparse(Matrix& matrix, const bool remove_self_loops) {
+    using Offset = typename Matrix::Offset;
+    const size_t n = matrix.n;
+
+    // no-ops if the arrays are already in memory or writable
+    matrix.ptr.resize(matrix.ptr.size());
+    matrix.val.resize(matrix.val.size());
+
+    Numa_vector<Offset> ptr(n + 1);
+
+    parallel_for(0, n, [&](size_t v) {
+        auto first = matrix.val.begin() + matrix.ptr[v];
+        auto last = matrix.val.begin() + matrix.ptr[v + 1];
+
+        if(!std::is_sorted(first, last)) std::sort(first, last);
+        last = std::unique(first, last);
+        if(remove_self_loops) last = std::remove(first, last, v);
+
+        ptr[v] = last - first;
+    });
+
+    const size_t nnz = parallel_exclusive_scan(ptr.data(), n + 1);
+    const size_t removed = matrix.nnz - nnz;
+    if(removed == 0) return 0;
+
+    // every list moves towards the front, so the lists before it are already out of the way
+    if(matrix.val.is_mapped()) {
+        for(size_t v = 0; v < n; v++) {
+            std::copy(matrix.val.begin() + matrix.ptr[v], matrix.val.begin() + matrix.ptr[v] + (ptr[v + 1] - ptr[v]), matrix.val.begin() + ptr[v]);
+        }
+        std::copy(ptr.begin(), ptr.end(), matrix.ptr.begin());
+
+        matrix.nnz = nnz;
+        matrix.val.resize(nnz);
+        return removed;
+    }
+
+    Numa_vector<typename Matrix::Vertex> val(nnz);
+    parallel_for(0, n, [&](size_t v) {
+        std::copy(matrix.val.begin() + matrix.ptr[v], matrix.val.begin() + matrix.ptr[v] + (ptr[v + 1] - ptr[v]), val.begin() + ptr[v]);
+    });
+
+    matrix.nnz = nnz;
+    matrix.ptr = std::move(ptr);
+    matrix.val = std::move(val);
+    return removed;
+}
+
+/**
+ * @brief Sorts and gap encodes every adjacency list. First the encoded size of each list is found in parallel,
+ * a prefix sum gives the byte offset of each list and then every list is encoded in place in parallel.
+ * @param matrix the matrix to compress, CSC or CSR
+ * @return the compressed matrix, of the same type
+ */
+template <typename Matrix>
+Compressed_matrix<typename Matrix::Vertex> compressSparse(const Matrix& matrix) {
+    using Vertex = typename Matrix::Vertex;
+    const size_t n = matrix.n;
+
+    // the lists are usually sorted already, only the ones that are not get copied and sorted
+    auto sorted_neighbors = [&](size_t v, std::vector<Vertex>& buffer) {
+        auto list = matrix.neighbors(v);
+        if(std::is_sorted(list.begin(), list.end())) return list;
+
+        buffer.assign(list.begin(), list.end());
+        std::sort(buffer.begin(), buffer.end());
+        return std::span<const Vertex>(buffer);
+    };
+
+    Numa_vector<uint64_t> ptr(n + 1);
+
+    parallel_for(0, n, [&](size_t v) {
+        thread_local std::vector<Vertex> buffer;
+        auto list = sorted_neighbors(v, buffer);
+        if(list.empty()) return;
+
+        size_t size = varint_size(zigzag_encode((int64_t) list[0] - (int64_t) v));
+        for(size_t i = 1; i < list.size(); i++) {
+            size += varint_size(list[i] - list[i - 1]);
+        }
+        ptr[v] = size;
+    });
+
+    const size_t total_bytes = parallel_exclusive_scan(ptr.data(), n + 1);
+    Numa_vector<uint8_t> bytes(total_bytes);
+
+    parallel_for(0, n, [&](size_t v) {
+        thread_local std::vector<Vertex> buffer;
+        auto list = sorted_neighbors(v, buffer);
+        if(list.empty()) return;
+
+        uint8_t* p = bytes.data() + ptr[v];
+        p = write_varint(p, zigzag_encode((int64_t) list[0] - (int64_t) v));
+        for(size_t i = 1; i < list.size(); i++) {
+            p = write_varint(p, list[i] - list[i - 1]);
+        }
+    });
+
+    return Compressed_matrix<Vertex>{n, matrix.nnz, std::move(ptr), std::move(bytes),
+                                     (typename Compressed_matrix<Vertex>::CSC_CSR) matrix.type};
+}
+
+template <typename Matrix>
+void csr_tocsc(const Matrix& csr, Matrix& csc) {
+    csc.n = csr.n;
+    csc.nnz = csr.nnz;
+    csc.ptr.resize(csr.n + 1);
+    csc.val.resize(csr.nnz);
+    csc.type = Matrix::CSC;
+
+    csr_tocsc(csr.n, csr.ptr, csr.val, csc.ptr, csc.val);
+}
+
+template <typename Matrix>
+void csc_tocsr(const Matrix& csc, Matrix& csr) {
+    csr_tocsc(csc, csr);
+    csr.type = Matrix::CSR;
+}
+
+/**
+ * @brief The number of blocks the entries of a transpose are split into. Every block has its own histogram of up to n
+ * offsets, so there are at most twice as many histogram entries as edges, and small matrices are done in one block.
+ * For many blocks parallel_scatter also caps the histograms by n, see SCATTER_HISTOGRAM_FACTOR.
+ * @param n the number of rows/columns
+ * @param nnz the number of entries
+ * @return the number of blocks
+ */
+static size_t transpose_blocks(const size_t n, const size_t nnz) {
+    if(nnz < (1 << 16)) return 1;
+    return std::max<size_t>(1, std::min(num_workers(), 2 * nnz / (n + 1)));
+}
+
+/**
+ * @brief Counting sort of the entries of a matrix by key, the core of every transpose. The entries are split into
+ * blocks that keep their order, every block counts its keys in its own histogram, the histograms are turned into
+ * the offset of every block inside every key and then every block scatters its entries without conflicts. The entries
+ * of a key end up in the order they were visited, so the output is the same as the one of the serial loop.
+ * The histograms are only as long as a range of the keys, so together they take at most SCATTER_HISTOGRAM_FACTOR * n
+ * counts whatever the number of blocks, and the ranges are sorted one after the other. A range also keeps the counts
+ * and the scattered entries in a smaller part of memory.
+ * @param n the number of keys
+ * @param blocks the number of blocks
+ * @param for_each_entry for_each_entry(b, f) calls f(key, value) for every entry of block b, in order
+ * @param Bp the offsets of every key, of size n + 1, in memory
+ * @param Bi the values sorted by key, of size nnz, in memory
+ * @return (void)
+ */
+template <typename VertexT, typename OffsetT, typename ForEach>
+static void parallel_scatter(const size_t n, const size_t blocks, ForEach&& for_each_entry,
+                             Index_array<OffsetT>& Bp, Index_array<VertexT>& Bi) {
+    const size_t passes = (blocks + SCATTER_HISTOGRAM_FACTOR - 1) / SCATTER_HISTOGRAM_FACTOR;
+    const size_t range = (n + passes - 1) / passes;
+    // not zero initialized here, every block clears its own histogram in parallel
+    std::unique_ptr<OffsetT[]> counts(new OffsetT[blocks * range]);
+
+    // the entries of the keys of the ranges before
+    OffsetT start = 0;
+    for(size_t first = 0; first < n; first += range) {
+        const size_t keys = std::min(range, n - first);
+        // the keys below first wrap around to large values, so one comparison checks both ends of the range
+        auto in_range = [&](const size_t key) { return key - first < keys; };
+
+        parallel_for(0, blocks, [&](size_t b) {
+            OffsetT* count = counts.get() + b * keys;
+            std::fill(count, count + keys, 0);
+            for_each_entry(b, [&](const size_t key, const size_t) {
+                if(in_range(key)) count[key - first]++;
+            });
+        });
+
+        // the number of entries of every key, and the offset of every block inside it
+        parallel_for(first, first + keys, [&](size_t key) {
+            OffsetT degree = 0;
+            for(size_t b = 0; b < blocks; b++) {
+                OffsetT temp = counts[b * keys + key - first];
+                counts[b * keys + key - first] = degree;
+                degree += temp;
+            }
+            Bp[key] = degree;
+        });
+        const OffsetT range_entries = parallel_exclusive_scan(Bp.data() + first, keys);
+        parallel_for(first, first + keys, [&](size_t key) {
+            Bp[key] += start;
+        });
+
+        parallel_for(0, blocks, [&](size_t b) {
+            OffsetT* count = counts.get() + b * keys;
+            for_each_entry(b, [&](const size_t key, const size_t value) {
+                if(in_range(key)) Bi[Bp[key] + count[key - first]++] = value;
+            });
+        });
+        start += range_entries;
+    }
+    Bp[n] = start;
+}
+
+template <typename VertexT, typename OffsetT>
+void csr_tocsc(const size_t n, const Index_array<OffsetT>& Ap, const Index_array<VertexT>& Aj, 
+	                Index_array<OffsetT>& Bp, Index_array<VertexT>& Bi) {  
+    const size_t nnz = Ap[n];
+    const size_t blocks = transpose_blocks(n, nnz);
+
+    // every block is a range of rows with about the same number of entries
+    std::vector<size_t> block_row(blocks + 1, n);
+    for(size_t b = 0; b < blocks; b++) {
+        block_row[b] = std::upper_bound(Ap.begin(), Ap.begin() + n + 1, (OffsetT)(b * nnz / blocks)) - Ap.begin() - 1;
+    }
+    block_row[0] = 0;
+
+    parallel_scatter(n, blocks, [&](size_t b, auto&& f) {
+        for(size_t row = block_row[b]; row < block_row[b + 1]; row++) {
+            for(size_t jj = Ap[row]; jj < Ap[row + 1]; jj++) {
+                f(Aj[jj], row);
+            }
+        }
+    }, Bp, Bi);
+}
+
+template <typename Matrix>
+void coo_tocsr(const Coo_matrix<typename Matrix::Vertex>& coo, Matrix& csr) {
+    csr.n = coo.n;
+    csr.nnz = coo.nnz;
+    csr.ptr.resize(coo.n + 1);
+    csr.val.resize(coo.nnz);
+    csr.type = Matrix::CSR;
+
+    const size_t blocks = transpose_blocks(coo.n, coo.nnz);
+    parallel_scatter(coo.n, blocks, [&](size_t b, auto&& f) {
+        for(size_t n = b * coo.nnz / blocks; n < (b + 1) * coo.nnz / blocks; n++) {
+            f(coo.Ai[n], coo.Aj[n]);
+        }
+    }, csr.ptr, csr.val);
+}
+
+template <typename Matrix>
+void coo_tocsc(const Coo_matrix<typename Matrix::Vertex>& coo, Matrix& csc) {
+    csc.n = coo.n;
+    csc.nnz = coo.nnz;
+    csc.ptr.resize(coo.n + 1);
+    csc.val.resize(coo.nnz);
+    csc.type = Matrix::CSC;
+
+    const size_t blocks = transpose_blocks(coo.n, coo.nnz);
+    parallel_scatter(coo.n, blocks, [&](size_t b, auto&& f) {
+        for(size_t n = b * coo.nnz / blocks; n < (b + 1) * coo.nnz / blocks; n++) {
+            f(coo.Aj[n], coo.Ai[n]);
+        }
+    }, csc.ptr, csc.val);
+}
+
+// levels of the RCM smaller than this are done by the calling thread, most components of web graphs are tiny
+#define PARALLEL_LEVEL_MIN 1024
+// the degrees of the counting sort of the orderings, the larger ones share the last bucket
+#define DEGREE_BUCKETS (1 << 16)
+// Gorder: the last vertices placed that the next one is scored against
+#define GORDER_WINDOW 5
+// Gorder: siblings are only counted through parents of at most this out-degree, and this many parents per vertex
+#define GORDER_MAX_DEGREE 16
+#define GORDER_MAX_PARENTS 4
+
+const char* vertexOrderName(const Vertex_order order) {
+    switch(order) {
+        case ORDER_DEGREE: return "degree";
+        case ORDER_RCM: return "rcm";
+        case ORDER_GORDER: return "gorder";
+        default: return "none";
+    }
+}
+
+// parallel_for for loops that are often too short to be worth waking the workers
+template <typename F>
+static void maybe_parallel_for(const size_t begin, const size_t end, F&& f) {
+    if(end - begin < PARALLEL_LEVEL_MIN) {
+        for(size_t i = begin; i < end; i++) f(i);
+    } else {
+        parallel_for(begin, end, f);
+    }
+}
+
+// parallel_exclusive_scan for the same short loops
+template <typename T>
+static T maybe_parallel_exclusive_scan(T* values, const size_t count) {
+    if(count < PARALLEL_LEVEL_MIN) {
+        T sum = 0;
+        for(size_t i = 0; i < count; i++) {
+            const T value = values[i];
+            values[i] = sum;
+            sum += value;
+        }
+        return sum;
+    }
+    return parallel_exclusive_scan(values, count);
+}
+
+/**
+ * @brief The vertices sorted by increasing degree with a counting sort, parallel for large graphs, equal degrees keep the
+ * order of their ids
+ * @param n the number of vertices
+ * @param degree degree(v) of every vertex
+ * @return the sorted vertices
+ */
+template <typename VertexT, typename Degree>
+static Index_array<VertexT> vertices_by_degree(const size_t n, Degree&& degree) {
+    // transpose_blocks would give one block, there are as many entries as keys here
+    const size_t blocks = n < (1 << 16) ? 1 : num_workers();
+    Index_array<VertexT> Bp{Numa_vector<VertexT>(DEGREE_BUCKETS + 1)};
+    Index_array<VertexT> Bi{Numa_vector<VertexT>(n)};
+
+    parallel_scatter(DEGREE_BUCKETS, blocks, [&](size_t b, auto&& f) {
+        for(size_t v = b * n / blocks; v < (b + 1) * n / blocks; v++) {
+            f(std::min<size_t>(degree(v), DEGREE_BUCKETS - 1), v);
+        }
+    }, Bp, Bi);
+    return Bi;
+}
+
+/**
+ * @brief Hub sorting: the vertices of more than average degree go first, by decreasing degree, the rest keep their
+ * order. The hubs are the vertices every gather touches, so they end up packed in a few cache lines and pages.
+ * @return new_id, see vertexOrder
+ */
+template <typename Matrix, typename Degree>
+static Numa_vector<typename Matrix::Vertex> degree_order(const size_t n, const size_t nnz, Degree&& degree) {
+    using Vertex = typename Matrix::Vertex;
+
+    // the hubs before every vertex
+    Numa_vector<Vertex> rank(n + 1);
+    parallel_for(0, n, [&](size_t v) {
+        rank[v] = degree(v) * n > nnz;
+    });
+    const size_t hub_count = parallel_exclusive_scan(rank.data(), n + 1);
+
+    Numa_vector<Vertex> hubs(hub_count);
+    Numa_vector<Vertex> new_id(n);
+    parallel_for(0, n, [&](size_t v) {
+        if(rank[v + 1] != rank[v]) {
+            hubs[rank[v]] = v;
+        } else {
+            new_id[v] = hub_count + v - rank[v];
+        }
+    });
+
+    std::stable_sort(hubs.begin(), hubs.end(), [&](Vertex a, Vertex b) { return degree(a) > degree(b); });
+    parallel_for(0, hub_count, [&](size_t i) {
+        new_id[hubs[i]] = i;
+    });
+    return new_id;
+}
+
+/**
+ * @brief Reverse Cuthill-McKee on the graph with its edges taken both ways, level synchronous and deterministic:
+ * every unplaced neighbor of a level is claimed by the first vertex of the level that reaches it (an atomic min over
+ * their positions), every vertex sorts its children by degree and a prefix sum over the level places them. Each
+ * component starts from its vertex of lowest degree. The result is the same for any number of workers.
+ * @return new_id, see vertexOrder
+ */
+template <typename Matrix, typename Degree, typename ForEachNeighbor>
+static Numa_vector<typename Matrix::Vertex> rcm_order(const size_t n, Degree&& degree, ForEachNeighbor&& for_each_neighbor) {
+    using Vertex = typename Matrix::Vertex;
+
+    const Index_array<Vertex> by_degree = vertices_by_degree<Vertex>(n, degree);
+
+    Numa_vector<Vertex> order(n);
+    // the position in order of the vertex that claimed each vertex, it is placed in the level after it
+    Numa_vector<Vertex> claimed(n);
+    Numa_vector<char> placed(n);
+    parallel_for(0, n, [&](size_t v) {
+        claimed[v] = std::numeric_limits<Vertex>::max();
+    });
+
+    // the children of every vertex of a level, turned into their offsets in the next one
+    std::vector<size_t> offsets;
+    size_t placed_count = 0;
+    size_t next_start = 0;
+    while(placed_count < n) {
+        while(placed[by_degree[next_start]]) next_start++;
+        order[placed_count] = by_degree[next_start];
+        placed[by_degree[next_start]] = true;
+
+        size_t begin = placed_count;
+        size_t end = placed_count + 1;
+        while(begin < end) {
+            maybe_parallel_for(begin, end, [&](size_t k) {
+                for_each_neighbor(order[k], [&](const size_t x) {
+                    if(placed[x]) return;
+                    std::atomic_ref<Vertex> slot(claimed[x]);
+                    Vertex current = slot.load(std::memory_order_relaxed);
+                    while(k < current && !slot.compare_exchange_weak(current, k, std::memory_order_relaxed)) {}
+                });
+            });
+
+            // only the claimer looks at placed[x] here, so marking it is race free and drops the duplicate edges
+            offsets.assign(end - begin + 1, 0);
+            maybe_parallel_for(begin, end, [&](size_t k) {
+                size_t children = 0;
+                for_each_neighbor(order[k], [&](const size_t x) {
+                    if(claimed[x] == k && !placed[x]) {
+                        placed[x] = true;
+                        children++;
+                    }
+                });
+                offsets[k - begin] = children;
+            });
+            const size_t level_size = maybe_parallel_exclusive_scan(offsets.data(), end - begin + 1);
+
+            maybe_parallel_for(begin, end, [&](size_t k) {
+                thread_local std::vector<Vertex> children;
+                children.clear();
+                for_each_neighbor(order[k], [&](const size_t x) {
+                    if(claimed[x] == k) children.push_back(x);
+                });
+                std::sort(children.begin(), children.end(), [&](Vertex a, Vertex b) {
+                    return degree(a) != degree(b) ? degree(a) < degree(b) : a < b;
+                });
+                children.erase(std::unique(children.begin(), children.end()), children.end());
+                std::copy(children.begin(), children.end(), order.begin() + end + offsets[k - begin]);
+            });
+
+            begin = end;
+            end += level_size;
+        }
+        placed_count = end;
+    }
+
+    Numa_vector<Vertex> new_id(n);
+    parallel_for(0, n, [&](size_t i) {
+        new_id[order[i]] = n - 1 - i;
+    });
+    return new_id;
+}
+
+/**
+ * @brief A lightweight Gorder: vertices are placed one at a time, the next one is the unplaced vertex with the most
+ * edges to and shared in-neighbors with the last GORDER_WINDOW placed ones, found with a lazy max heap of the scores.
+ * Shared in-neighbors are only counted through parents of low out-degree, which bounds the work per vertex. When no
+ * vertex scores, the unplaced vertex of highest in-degree is next. Serial, as Gorder is. Without the CSR only the
+ * in-edges are scored.
+ * @return new_id, see vertexOrder
+ */
+template <typename Matrix>
+static Numa_vector<typename Matrix::Vertex> gorder_order(const Matrix& csc, const Matrix* csr) {
+    using Vertex = typename Matrix::Vertex;
+    const size_t n = csc.n;
+
+    const Index_array<Vertex> by_in_degree = vertices_by_degree<Vertex>(n, [&](size_t v) { return csc.ptr[v + 1] - csc.ptr[v]; });
+
+    Numa_vector<uint32_t> score(n);
+    Numa_vector<char> placed(n);
+    std::priority_queue<std::pair<uint32_t, Vertex>> heap;
+
+    // the score of every unplaced vertex related to u goes up by one when u enters the window and down when it leaves
+    auto update = [&](const size_t u, const bool entering) {
+        auto bump = [&](const size_t x) {
+            if(placed[x]) return;
+            if(entering) {
+                heap.push({++score[x], x});
+            } else {
+                score[x]--;
+            }
+        };
+
+        size_t parents = 0;
+        for(const size_t x : csc.neighbors(u)) {
+            bump(x);
+            if(csr != nullptr && parents < GORDER_MAX_PARENTS && csr->ptr[x + 1] - csr->ptr[x] <= GORDER_MAX_DEGREE) {
+                parents++;
+                for(const size_t sibling : csr->neighbors(x)) {
+                    if(sibling != u) bump(sibling);
+                }
+            }
+        }
+        if(csr != nullptr) {
+            for(const size_t x : csr->neighbors(u)) bump(x);
+        }
+    };
+
+    Numa_vector<Vertex> new_id(n);
+    std::deque<Vertex> window;
+    size_t next_hub = n;
+    for(size_t i = 0; i < n; i++) {
+        // the stale entries are dropped now and then, so the heap stays O(n)
+        if(heap.size() > 2 * n + 4096) {
+            heap = {};
+            for(size_t x = 0; x < n; x++) {
+                if(!placed[x] && score[x] > 0) heap.push({score[x], x});
+            }
+        }
+
+        // entries are pushed on every increase, an entry is stale if its vertex was placed or its score dropped since
+        Vertex v = std::numeric_limits<Vertex>::max();
+        while(!heap.empty()) {
+            const auto [s, x] = heap.top();
+            heap.pop();
+            if(placed[x] || score[x] == 0) continue;
+            if(s == score[x]) {
+                v = x;
+                break;
+            }
+            if(s > score[x]) heap.push({score[x], x});
+        }
+        if(v == std::numeric_limits<Vertex>::max()) {
+            while(placed[by_in_degree[next_hub - 1]]) next_hub--;
+            v = by_in_degree[--next_hub];
+        }
+
+        placed[v] = true;
+        new_id[v] = i;
+        update(v, true);
+        window.push_back(v);
+        if(window.size() > GORDER_WINDOW) {
+            update(window.front(), false);
+            window.pop_front();
+        }
+    }
+    return new_id;
+}
+
+/**
+ * @brief Finds an ordering of the vertices of a graph, see Vertex_order
+ * @param csc the graph in CSC format
+ * @param csr the graph in CSR format, or nullptr if it is not made: the orderings then only see the in-edges
+ * @param order the ordering
+ * @return new_id, new_id[v] is the position of vertex v in the order
+ */
+template <typename Matrix>
+Numa_vector<typename Matrix::Vertex> vertexOrder(const Matrix& csc, const Matrix* csr, const Vertex_order order) {
+    const size_t n = csc.n;
+
+    auto degree = [&](const size_t v) -> size_t {
+        return csc.ptr[v + 1] - csc.ptr[v] + (csr != nullptr ? csr->ptr[v + 1] - csr->ptr[v] : 0);
+    };
+    auto for_each_neighbor = [&](const size_t v, auto&& f) {
+        for(const size_t x : csc.neighbors(v)) f(x);
+        if(csr != nullptr) {
+            for(const size_t x : csr->neighbors(v)) f(x);
+        }
+    };
+
+    switch(order) {
+        case ORDER_DEGREE: return degree_order<Matrix>(n, csc.nnz + (csr != nullptr ? csr->nnz : 0), degree);
+        case ORDER_RCM: return rcm_order<Matrix>(n, degree, for_each_neighbor);
+        case ORDER_GORDER: return gorder_order(csc, csr);
+        default: break;
+    }
+
+    Numa_vector<typename Matrix::Vertex> new_id(n);
+    parallel_for(0, n, [&](size_t v) {
+        new_id[v] = v;
+    });
+    return new_id;
+}
+
+/**
+ * @brief Renumbers the vertices of a matrix in parallel: the list of every new vertex is the list of its old vertex
+ * with every neighbor renumbered, lists that were sorted are sorted again
+ * @param matrix the matrix, CSC or CSR, mapped arrays are replaced by arrays in memory
+ * @param new_id new_id[v] is the new id of vertex v
+ * @return (void)
+ */
+template <typename Matrix>
+void permuteSparse(Matrix& matrix, const Numa_vector<typename Matrix::Vertex>& new_id) {
+    using Vertex = typename Matrix::Vertex;
+    using Offset = typename Matrix::Offset;
+    const size_t n = matrix.n;
+
+    Numa_vector<Vertex> old_id(n);
+    parallel_for(0, n, [&](size_t v) {
+        old_id[new_id[v]] = v;
+    });
+
+    Numa_vector<Offset> ptr(n + 1);
+    parallel_for(0, n, [&](size_t v) {
+        ptr[v] = matrix.ptr[old_id[v] + 1] - matrix.ptr[old_id[v]];
+    });
+    parallel_exclusive_scan(ptr.data(), n + 1);
+
+    Numa_vector<Vertex> val(matrix.nnz);
+    parallel_for(0, n, [&](size_t v) {
+        auto list = matrix.neighbors(old_id[v]);
+        const bool sorted = std::is_sorted(list.begin(), list.end());
+
+        auto first = val.begin() + ptr[v];
+        std::transform(list.begin(), list.end(), first, [&](Vertex u) { return new_id[u]; });
+        if(sorted) std::sort(first, first + list.size());
+    });
+
+    matrix.ptr = std::move(ptr);
+    matrix.val = std::move(val);
+}
+
+template <typename VertexT>
+void permuteBack(Numa_vector<VertexT>& values, const Numa_vector<VertexT>& new_id) {
+    Numa_vector<VertexT> original(values.size());
+    parallel_for(0, values.size(), [&](size_t v) {
+        original[v] = values[new_id[v]];
+    });
+    values = std::move(original);
+}
+
+// the index widths main can pick at load time
+#define INSTANTIATE_SPARSE_UTIL(Matrix) \
+    template Matrix loadFileToCSC<Matrix>(const std::string filename, const Degrees_ready<Matrix::Offset>& on_degrees); \
+    template void loadFileToCSCAndCSR<Matrix>(const std::string filename, Matrix& csc, Matrix& csr, const Degrees_ready<Matrix::Offset>& on_degrees); \
+    template void saveSparseToBinary<Matrix>(const Matrix& matrix, const std::string filename); \
+    template Matrix loadBinaryToSparse<Matrix>(const std::string filename, const bool verify_checksum); \
+    template size_t loadFileToBinaryCSC<Matrix>(const std::string filename, const std::string binary_filename, const bool canonicalize, const bool remove_self_loops); \
+    template void coo_tocsr<Matrix>(const Coo_matrix<Matrix::Vertex>& coo, Matrix& csr); \
+    template void coo_tocsc<Matrix>(const Coo_matrix<Matrix::Vertex>& coo, Matrix& csc); \
+    template void csc_tocsr<Matrix>(const Matrix& csc, Matrix& csr); \
+    template void csr_tocsc<Matrix>(const Matrix& csr, Matrix& csc); \
+    template size_t canonicalizeSparse<Matrix>(Matrix& matrix, const bool remove_self_loops); \
+    template Compressed_matrix<Matrix::Vertex> compressSparse<Matrix>(const Matrix& matrix); \
+    template Numa_vector<Matrix::Vertex> vertexOrder<Matrix>(const Matrix& csc, const Matrix* csr, const Vertex_order order); \
+    template void permuteSparse<Matrix>(Matrix& matrix, const Numa_vector<Matrix::Vertex>& new_id);
+
+INSTANTIATE_SPARSE_UTIL(Sparse_matrix_32)
+INSTANTIATE_SPARSE_UTIL(Sparse_matrix_32_64)
+INSTANTIATE_SPARSE_UTIL(Sparse_matrix_64)
+
+template Coo_matrix<uint32_t> loadFileToCoo<uint32_t>(const std::string filename);
+template Coo_matrix<uint64_t> loadFileToCoo<uint64_t>(const std::string filename);
+
+template void permuteBack<uint32_t>(Numa_vector<uint32_t>& values, const Numa_vector<uint32_t>& new_id);
+template void permuteBack<uint64_t>(Numa_vector<uint64_t>& values, const Numa_vector<uint64_t>& new_id);
@@ -2,34 +2,459 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <iterator>
+#include <functional>
 
+/**
+ * @brief A memory mapping of a whole file. Unmaps the file when it goes out of scope. Existing files are mapped
+ * read only, a file made with a size is mapped shared and writable, so what is written to it ends up in the file.
+ */
+struct Mapped_file {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool writable = false;
+
+    Mapped_file(const std::string& filename);
+    // creates or truncates the file to size bytes
+    Mapped_file(const std::string& filename, const size_t size);
+    ~Mapped_file();
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+};
+
+// where the pages of the large arrays go on machines with more than one NUMA node: on the node of the thread that
+// first writes them, or spread round robin over all nodes
+enum Numa_placement {NUMA_FIRST_TOUCH, NUMA_INTERLEAVE};
+
+void setNumaPlacement(const Numa_placement placement);
+
+// the pages behind the large arrays: normal, transparent huge pages, or reserved 2MB or 1GB hugetlbfs pages that
+// fall back to transparent huge pages and then to normal pages when none are free. Set before allocating anything.
+enum Page_size {PAGES_NORMAL, PAGES_TRANSPARENT_HUGE, PAGES_HUGETLB_2M, PAGES_HUGETLB_1G};
+
+void setPageSize(const Page_size page_size);
+
+// the number of large allocations that asked for hugetlbfs pages and got smaller pages
+size_t hugePageFallbacks();
+
+// the memory behind Numa_allocator, zeroed but untouched, so no page is placed yet, see setNumaPlacement and setPageSize
+void* numaAllocate(const size_t bytes);
+void numaDeallocate(void* data, const size_t bytes);
+
+/**
+ * @brief Allocator for the large per vertex and per edge arrays. Making an element without a value leaves the zero
+ * the memory came with, so a vector of n elements touches no page when it is made: the pages are placed by the parallel
+ * loops that fill it, each on the node of its thread, instead of all on the node of the thread that made the vector.
+ * A vector shrunk and grown back keeps its old values in the regrown part, use assign to reset it.
+ */
+template <typename T>
+struct Numa_allocator {
+    using value_type = T;
+
+    Numa_allocator() = default;
+    template <typename U>
+    Numa_allocator(const Numa_allocator<U>&) {}
+
+    T* allocate(const size_t count) { return (T*) numaAllocate(count * sizeof(T)); }
+    void deallocate(T* data, const size_t count) { numaDeallocate(data, count * sizeof(T)); }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        if constexpr(sizeof...(Args) == 0) {
+            ::new((void*) p) U;
+        } else {
+            ::new((void*) p) U(std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const Numa_allocator<U>&) const { return true; }
+};
+
+template <typename T>
+using Numa_vector = std::vector<T, Numa_allocator<T>>;
+
+// how the pages of a mapped array will be used, only a hint for the kernel
+enum Access_pattern {ACCESS_NORMAL, ACCESS_SEQUENTIAL, ACCESS_RANDOM, ACCESS_WILL_NEED};
+
+// madvise over the whole pages of [data, data + bytes)
+void adviseMapped(const void* data, const size_t bytes, const Access_pattern pattern);
+
+/**
+ * @brief A contiguous array of indices. It either owns its memory, like a std::vector, or is a view into a
+ * memory mapped file that it keeps mapped for as long as it exists. Only arrays of writable mappings may be written to.
+ */
+template <typename T>
+class Index_array {
+public:
+    Index_array() = default;
+
+    Index_array(Numa_vector<T>&& owned) : storage(std::move(owned)), first(storage.data()), count(storage.size()) {}
+
+    Index_array(std::shared_ptr<const Mapped_file> file, const size_t offset, const size_t size)
+        : mapping(std::move(file)), first((T*)(mapping->data + offset)), count(size) {}
+
+    Index_array(const Index_array& other) : storage(other.storage), mapping(other.mapping), count(other.count) {
+        first = mapping ? other.first : storage.data();
+    }
+
+    Index_array(Index_array&& other) noexcept
+        : storage(std::move(other.storage)), mapping(std::move(other.mapping)), first(other.first), count(other.count) {
+        other.first = nullptr;
+        other.count = 0;
+    }
+
+    Index_array& operator=(Index_array other) noexcept {
+        std::swap(storage, other.storage);
+        std::swap(mapping, other.mapping);
+        std::swap(first, other.first);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    T& operator[](const size_t i) { return first[i]; }
+    const T& operator[](const size_t i) const { return first[i]; }
+
+    T* data() { return first; }
+    const T* data() const { return first; }
+
+    T* begin() { return first; }
+    T* end() { return first + count; }
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool is_mapped() const { return mapping != nullptr; }
+    bool is_writable() const { return !mapping || mapping->writable; }
+
+    // a mapped array is copied into memory before it is resized, a writable one is only shrunk in place
+    void resize(const size_t size) {
+        if(mapping && mapping->writable && size <= count) {
+            count = size;
+            return;
+        }
+        if(mapping) {
+            storage.assign(first, first + std::min(count, size));
+            mapping.reset();
+        }
+        storage.resize(size);
+        first = storage.data();
+        count = size;
+    }
+
+    // no-op for arrays in memory
+    void advise(const size_t begin, const size_t end, const Access_pattern pattern) const {
+        if(mapping && begin < end) adviseMapped(first + begin, (end - begin) * sizeof(T), pattern);
+    }
+
+private:
+    Numa_vector<T> storage;
+    std::shared_ptr<const Mapped_file> mapping;
+    T* first = nullptr;
+    size_t count = 0;
+};
+
+template <typename VertexT>
 struct Coo_matrix {
+    using Vertex = VertexT;
+
     size_t n;
     size_t nnz;
-    std::vector<size_t> Ai;
-    std::vector<size_t> Aj;
+    Numa_vector<VertexT> Ai;
+    Numa_vector<VertexT> Aj;
 };
 
+/**
+ * @brief CSC or CSR matrix. VertexT is the type of the row/column indices in val, OffsetT the type of the offsets in ptr,
+ * so a graph with less than 2^32 vertices and edges needs half the memory of the size_t version.
+ */
+template <typename VertexT, typename OffsetT>
 struct Sparse_matrix {
+    using Vertex = VertexT;
+    using Offset = OffsetT;
+
     size_t n;
     size_t nnz;
-    std::vector<size_t> ptr;
-    std::vector<size_t> val;
+    Index_array<OffsetT> ptr;
+    Index_array<VertexT> val;
 
     enum CSC_CSR {CSC, CSR};
     CSC_CSR type;
+
+    // the rows of column v for CSC, the columns of row v for CSR
+    std::span<const VertexT> neighbors(const size_t v) const {
+        return std::span<const VertexT>(val.data() + ptr[v], ptr[v + 1] - ptr[v]);
+    }
+
+    bool has_neighbors(const size_t v) const {
+        return ptr[v] != ptr[v + 1];
+    }
+
+    size_t degree(const size_t v) const {
+        return ptr[v + 1] - ptr[v];
+    }
+
+    size_t memory_size() const {
+        return ptr.size() * sizeof(OffsetT) + val.size() * sizeof(VertexT);
+    }
+
+    // hints for matrices mapped from the binary cache, they do nothing for matrices in memory
+    void advise(const Access_pattern pattern) const {
+        ptr.advise(0, ptr.size(), pattern);
+        val.advise(0, val.size(), pattern);
+    }
+
+    // starts reading the lists of the vertices [first, last) from disk
+    void will_need(const size_t first, const size_t last) const {
+        if(!val.is_mapped() || first >= last) return;
+        ptr.advise(first, last + 1, ACCESS_WILL_NEED);
+        val.advise(ptr[first], ptr[last], ACCESS_WILL_NEED);
+    }
 };
 
-Coo_matrix loadFileToCoo(const std::string filename);
+// LEB128 varints: 7 bits per byte, the high bit is set on every byte but the last
+inline uint64_t read_varint(const uint8_t*& p) {
+    uint64_t value = *p & 0x7f;
+    // most gaps of web graphs fit in one byte
+    if(*p++ < 0x80) return value;
+
+    for(int shift = 7;; shift += 7) {
+        value |= (uint64_t)(*p & 0x7f) << shift;
+        if(*p++ < 0x80) return value;
+    }
+}
+
+inline uint8_t* write_varint(uint8_t* p, uint64_t value) {
+    while(value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+inline size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// maps signed differences to small unsigned values: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+inline uint64_t zigzag_encode(const int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t zigzag_decode(const uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief The neighbors of one vertex of a Compressed_matrix, decoded while iterating. The first neighbor is stored
+ * as the zigzag encoded difference from the vertex itself, the rest as the gap from the previous neighbor.
+ */
+template <typename VertexT>
+class Varint_neighbors {
+public:
+    class iterator {
+    public:
+        iterator(const uint8_t* first, const uint8_t* last, const size_t vertex) : next(first), last(last), done(first == last) {
+            if(!done) value = vertex + zigzag_decode(read_varint(next));
+        }
+
+        VertexT operator*() const { return value; }
+
+        iterator& operator++() {
+            if(next == last) {
+                done = true;
+            } else {
+                value += read_varint(next);
+            }
+            return *this;
+        }
+
+        bool operator==(std::default_sentinel_t) const { return done; }
+        bool operator!=(std::default_sentinel_t) const { return !done; }
+
+    private:
+        const uint8_t* next;
+        const uint8_t* last;
+        VertexT value = 0;
+        bool done;
+    };
+
+    Varint_neighbors(const uint8_t* first, const uint8_t* last, const size_t vertex) : first(first), last(last), vertex(vertex) {}
+
+    iterator begin() const { return iterator(first, last, vertex); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+    const uint8_t* first;
+    const uint8_t* last;
+    size_t vertex;
+};
+
+/**
+ * @brief CSC or CSR matrix with every adjacency list sorted and gap encoded as varints. ptr holds the byte offset
+ * of the list of each vertex, so it is the index that lets every vertex start decoding on its own. Web graphs
+ * have high locality, so most gaps take one byte instead of the four or eight of Sparse_matrix::val.
+ */
+template <typename VertexT>
+struct Compressed_matrix {
+    using Vertex = VertexT;
+    using Offset = uint64_t;
+
+    size_t n;
+    size_t nnz;
+    Index_array<uint64_t> ptr;
+    Index_array<uint8_t> bytes;
+
+    enum CSC_CSR {CSC, CSR};
+    CSC_CSR type;
+
+    Varint_neighbors<VertexT> neighbors(const size_t v) const {
+        return Varint_neighbors<VertexT>(bytes.data() + ptr[v], bytes.data() + ptr[v + 1], v);
+    }
+
+    bool has_neighbors(const size_t v) const {
+        return ptr[v] != ptr[v + 1];
+    }
+
+    // every varint ends with the one byte that has the high bit clear, so the list is counted without decoding it
+    size_t degree(const size_t v) const {
+        return std::count_if(bytes.data() + ptr[v], bytes.data() + ptr[v + 1], [](const uint8_t byte) { return byte < 0x80; });
+    }
+
+    size_t memory_size() const {
+        return ptr.size() * sizeof(uint64_t) + bytes.size();
+    }
+
+    // see Sparse_matrix::advise and Sparse_matrix::will_need
+    void advise(const Access_pattern pattern) const {
+        ptr.advise(0, ptr.size(), pattern);
+        bytes.advise(0, bytes.size(), pattern);
+    }
+
+    void will_need(const size_t first, const size_t last) const {
+        if(!bytes.is_mapped() || first >= last) return;
+        ptr.advise(first, last + 1, ACCESS_WILL_NEED);
+        bytes.advise(ptr[first], ptr[last], ACCESS_WILL_NEED);
+    }
+};
+
+// the index widths main picks from at load time, the largest vertex value is kept free to mark unassigned vertices
+using Sparse_matrix_32 = Sparse_matrix<uint32_t, uint32_t>;
+using Sparse_matrix_32_64 = Sparse_matrix<uint32_t, uint64_t>;
+using Sparse_matrix_64 = Sparse_matrix<uint64_t, uint64_t>;
+
+struct Matrix_size {
+    size_t rows = 0;
+    size_t cols = 0;
+    // the entries stored in the file
+    size_t nnz = 0;
+
+    // symmetric, skew-symmetric and hermitian files store one triangle, the other is added when loading
+    bool symmetric = false;
+    // the entries have no value
+    bool pattern = false;
+
+    // the edges of the loaded graph can be at most this many, the diagonal is not mirrored
+    size_t max_edges() const { return symmetric ? 2 * nnz : nnz; }
+};
+
+// the formats the loaders below read, text formats may also be gzip, xz or zstd compressed
+enum Graph_format {MATRIX_MARKET, SNAP, METIS, GALOIS_GR};
+
+// by the extension, or by sniffing the start of the file for unknown extensions
+Graph_format graphFormatOf(const std::string filename);
+const char* graphFormatName(const Graph_format format);
+
+// "graph.mtx.gz" -> "graph.mtx", other names are returned as they are
+std::string stripCompressionExtension(const std::string filename);
+
+// reads only the header of a graph file, except for SNAP edge lists that have none
+Matrix_size loadFileSize(const std::string filename);
+
+template <typename VertexT>
+Coo_matrix<VertexT> loadFileToCoo(const std::string filename);
+
+// given to the loaders to pipeline them: called as soon as the degrees are final, on its own thread while the lists are
+// still being filled. The in-degree of v is in_ptr[v + 1] - in_ptr[v], out_ptr is nullptr when the CSR is not made.
+// The degrees count the duplicate edges and self loops that canonicalizing may remove later.
+template <typename OffsetT>
+using Degrees_ready = std::function<void(const size_t n, const OffsetT* in_ptr, const OffsetT* out_ptr)>;
+
+template <typename Matrix>
+Matrix loadFileToCSC(const std::string filename, const Degrees_ready<typename Matrix::Offset>& on_degrees = nullptr);
+
+// builds both from the same parse, no transpose needed
+template <typename Matrix>
+void loadFileToCSCAndCSR(const std::string filename, Matrix& csc, Matrix& csr, const Degrees_ready<typename Matrix::Offset>& on_degrees = nullptr);
+
+// binary cache of a Sparse_matrix, loading maps the file instead of reading it
+template <typename Matrix>
+void saveSparseToBinary(const Matrix& matrix, const std::string filename);
+
+template <typename Matrix>
+Matrix loadBinaryToSparse(const std::string filename, const bool verify_checksum);
+
+bool isBinaryUpToDate(const std::string binary_filename, const std::string source_filename);
+
+// makes the binary cache of the CSC straight from a graph file, without the matrix ever being in memory
+// returns the number of edges removed while canonicalizing
+template <typename Matrix>
+size_t loadFileToBinaryCSC(const std::string filename, const std::string binary_filename, const bool canonicalize, const bool remove_self_loops);
+
+// sorts every adjacency list and removes the duplicate edges and, if asked, the self loops
+// returns the number of edges removed
+template <typename Matrix>
+size_t canonicalizeSparse(Matrix& matrix, const bool remove_self_loops);
+
+// sorts and gap encodes every adjacency list, the result has the same neighbors as the input
+template <typename Matrix>
+Compressed_matrix<typename Matrix::Vertex> compressSparse(const Matrix& matrix);
+
+// orderings of the vertices that put vertices used together close together, for the locality of the kernels:
+// hubs first by degree, reverse Cuthill-McKee, or a lightweight Gorder
+enum Vertex_order {ORDER_NONE, ORDER_DEGREE, ORDER_RCM, ORDER_GORDER};
+
+const char* vertexOrderName(const Vertex_order order);
+
+// new_id[v] is the position of vertex v in the order, csr may be nullptr
+template <typename Matrix>
+Numa_vector<typename Matrix::Vertex> vertexOrder(const Matrix& csc, const Matrix* csr, const Vertex_order order);
+
+// renumbers the vertices of a CSC or CSR, sorted adjacency lists stay sorted
+template <typename Matrix>
+void permuteSparse(Matrix& matrix, const Numa_vector<typename Matrix::Vertex>& new_id);
+
+// values[v] becomes values[new_id[v]], the results on a renumbered graph go back to the original vertex ids
+template <typename VertexT>
+void permuteBack(Numa_vector<VertexT>& values, const Numa_vector<VertexT>& new_id);
 
-Sparse_matrix loadFileToCSC(const std::string filename);
+template <typename Matrix>
+void coo_tocsr(const Coo_matrix<typename Matrix::Vertex>& coo, Matrix& csr);
 
-void coo_tocsr(const Coo_matrix& coo, Sparse_matrix& csr);
+template <typename Matrix>
+void coo_tocsc(const Coo_matrix<typename Matrix::Vertex>& coo, Matrix& csc);
 
-void coo_tocsc(const Coo_matrix& coo, Sparse_matrix& csc);
+template <typename VertexT, typename OffsetT>
+void csr_tocsc(const size_t n, const Index_array<OffsetT>& Ap, const Index_array<VertexT>& Aj,
+	                Index_array<OffsetT>& Bp, Index_array<VertexT>& Bi);
 
-void csr_tocsc(const size_t n, const std::vector<size_t>& Ap, const std::vector<size_t>& Aj, 
-	                std::vector<size_t>& Bp, std::vector<size_t>& Bi);
+template <typename Matrix>
+void csc_tocsr(const Matrix& csc, Matrix& csr);
 
-void csc_tocsr(const Sparse_matrix& csc, Sparse_matrix& csr);
-void csr_tocsc(const Sparse_matrix& csr, Sparse_matrix& csc);
\ No newline at end of file
+template <typename Matrix>
+void csr_tocsc(const Matrix& csr, Matrix& csc);
@@ -0,0 +1,17 @@
+function reorder_bench --argument times threads_start threads_step threads_end --description="Compares the OpenMP version on the file order and after each vertex reordering, for different thread counts"
+    # usage: reorder_bench 5 1 1 12
+    # every run prints the baseline, the reordered time, the cost of reordering and both speedups on one line
+    mkdir -p results/reorder
+
+    cd OpenMP
+    make clean
+    make
+    for i in (seq $threads_start $threads_step $threads_end)
+        export OMP_NUM_THREADS=$i
+        for order in degree rcm gorder
+            echo "Running with $i threads, $order order"
+            ./colorSCC ../../matrices $times 0 1 --reorder=$order | tee ../results/reorder/$order"_threads_"$i.txt
+        end
+    end
+    cd ..
+end
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 
@@ -6,18 +8,76 @@
 #define DEB(x) if(DEBUG) {std::cout << x << std::endl;}
 
 // only for the first time, where all SCC_ids are -1
-size_t trimVertices_inplace_first_time(const Sparse_matrix& inb, const Sparse_matrix& onb, std::vector<size_t>& SCC_id, const size_t SCC_count);
+template <typename Matrix>
+size_t trimVertices_inplace_first_time(const Matrix& inb, const Matrix& onb, Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count);
 
-size_t trimVertices_inplace_first_time_single_direction(const Sparse_matrix& nb, std::vector<size_t>& SCC_id, const size_t SCC_count);
+template <typename Matrix>
+size_t trimVertices_inplace_first_time_single_direction(const Matrix& nb, Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count);
 
 // normal trimmer
-size_t trimVertices_inplace(const Sparse_matrix& inb, const Sparse_matrix& onb, const std::vector<bool>& vleft,
-                                    std::vector<size_t>& SCC_id, size_t SCC_count);
+template <typename Matrix>
+size_t trimVertices_inplace(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                    Numa_vector<typename Matrix::Vertex>& SCC_id, size_t SCC_count);
+
+template <typename Matrix>
+size_t trimVertices_inplace_single_direction(const Matrix& inb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                                    Numa_vector<typename Matrix::Vertex>& SCC_id, size_t SCC_count);
+
+// the optional phases of colorSCC_no_conversion, set from the flags of main
+struct Scc_options {
+    // after the first trim, take the SCC of a high degree pivot with a forward and a backward search, as Multistep
+    // does for the giant SCC of web graphs, see fwbwPivot. Needs onb, it is skipped without it.
+    bool FW_BW = false;
+    // after every trim of single vertices, also trim the SCCs of size 2 whose vertices only have each other as live
+    // neighbors on one side, see trimPairs_inplace
+    bool TRIM2 = false;
+    // and the SCCs of size 3 closed on one side, see trimTriples_inplace
+    bool TRIM3 = false;
+    // trim with a worklist on live degree counts instead of rescanning the edges left every iteration, see
+    // trimWorklist_inplace. Needs onb, the scanning trims are used without it.
+    bool WORKLIST_TRIM = false;
+    // color with frontier sweeps that only visit the vertices whose incoming neighbors changed color, see
+    // colorFrontier_inplace. Needs onb, the full sweeps are used without it.
+    bool FRONTIER_COLORING = false;
+    // the frontier coloring, pushing the colors of small frontiers along onb with an atomic min and pulling over
+    // vleft for large ones, chosen every sweep from the edge counts
+    bool PUSH_PULL = false;
+    // after every coloring sweep, every vertex takes the color of the vertex its color names, pointer jumping as in
+    // Shiloach-Vishkin, see shortcutColors_inplace
+    bool SHORTCUT = false;
+    // the colors with many vertices get a level synchronous parallel BFS, direction optimizing with onb, the small ones
+    // keep the serial BFS, see bfsGiantColors_inplace
+    bool PARALLEL_BFS = false;
+    // once few vertices are left, run the rest on the subgraph they induce, renumbered and with only the live edges, so
+    // the late iterations fit in the cache, see inducedSubgraph
+    bool COMPACT = false;
+};
+
+// the first trim done from the degrees alone while the graph is loading, see Degrees_ready: the vertices without
+// incoming or outgoing edges get the SCC ids 1 to count, the rest are unassigned
+template <typename VertexT>
+struct First_trim {
+    Numa_vector<VertexT> SCC_id;
+    size_t count = 0;
+};
+
+// serial, it runs on the thread of Degrees_ready next to the parallel scatter of the loader
+template <typename VertexT, typename OffsetT>
+First_trim<VertexT> trimFromDegrees(const size_t n, const OffsetT* in_ptr, const OffsetT* out_ptr);
+
+template <typename Matrix>
+void reach_inplace(const Matrix& nb, const size_t source, const Numa_vector<typename Matrix::Vertex>& SCC_id, Numa_vector<char>& reached);
 
-size_t trimVertices_inplace_single_direction(const Sparse_matrix& inb, const std::vector<bool>& vleft,
-                                    std::vector<size_t>& SCC_id, size_t SCC_count);
+template <typename Matrix>
+size_t fwbwPivot(const Matrix& inb, const Matrix& onb, const Numa_vector<typename Matrix::Vertex>& vleft,
+                 Numa_vector<typename Matrix::Vertex>& SCC_id, const size_t SCC_count);
 
-void bfs_colors_inplace(const Sparse_matrix& nb, const size_t source, std::vector<size_t>& SCC_id,
-    const size_t SCC_count, const std::vector<size_t>& colors, const size_t color);
+template <typename Matrix>
+void bfs_colors_inplace(const Matrix& nb, const size_t source, Numa_vector<typename Matrix::Vertex>& SCC_id,
+    const size_t SCC_count, const Numa_vector<typename Matrix::Vertex>& colors, const size_t color);
 
-std::vector<size_t> colorSCC_no_conversion(const Sparse_matrix& inb, const Sparse_matrix& onb, bool USE_ONB, bool DEBUG);
+// instantiated for Sparse_matrix_32, Sparse_matrix_32_64, Sparse_matrix_64 and their Compressed_matrix versions
+template <typename Matrix>
+Numa_vector<typename Matrix::Vertex> colorSCC_no_conversion(const Matrix& inb, const Matrix& onb, bool USE_ONB, bool DEBUG,
+                                                             const First_trim<typename Matrix::Vertex>* first_trim = nullptr,
+                                                             const Scc_options& options = Scc_options());